@@ -0,0 +1,119 @@
+#include "batch.h"
+
+#include <algorithm>
+
+#include "evaluation.h"
+#include "movegen.h"
+
+namespace {
+
+// Positions per step of the batch loops; their temporaries stay in L1.
+constexpr size_t kBlock = 256;
+
+// Number of free rings of positions [begin, begin + n). Loops over the
+// positions innermost, with the cells and edges of the board as constants,
+// so that they run on whole vectors of ring masks.
+template <BoardVariant V>
+void CountFreeRings(const PositionBatch& batch, size_t begin, size_t n, Mask* out) {
+  using Tables = HexTables<V>;
+  const Mask* rings = batch.rings.data() + begin;
+  const Mask* white = batch.balls[0].data() + begin;
+  const Mask* grey = batch.balls[1].data() + begin;
+  const Mask* black = batch.balls[2].data() + begin;
+  Mask vacant[kBlock];
+  for (size_t i = 0; i < n; ++i) {
+    vacant[i] = rings[i] & ~(white[i] | grey[i] | black[i]);
+    out[i] = 0;
+  }
+  for (int cell = 0; cell < Tables::kNumCells; ++cell) {
+    const auto& edges = Tables::kFreeEdges[cell];
+    for (size_t i = 0; i < n; ++i) {
+      Mask free = 0;
+      for (int d = 0; d < kNumDirections; ++d) {
+        free |= Mask{(rings[i] & edges[d]) == 0};
+      }
+      out[i] += free & (vacant[i] >> cell);
+    }
+  }
+}
+
+}
+
+void PositionBatch::Reserve(size_t n) {
+  rings.reserve(n);
+  for (int c = 0; c < kNumColors; ++c) {
+    balls[c].reserve(n);
+    for (int pile = 0; pile < kPiles; ++pile) {
+      counts[pile][c].reserve(n);
+    }
+  }
+  to_move.reserve(n);
+  chain_cell.reserve(n);
+}
+
+void PositionBatch::Clear() {
+  rings.clear();
+  for (int c = 0; c < kNumColors; ++c) {
+    balls[c].clear();
+    for (int pile = 0; pile < kPiles; ++pile) {
+      counts[pile][c].clear();
+    }
+  }
+  to_move.clear();
+  chain_cell.clear();
+}
+
+void PositionBatch::Add(const Position& pos) {
+  assert(pos.board.Variant() == variant);
+  int me = Index(pos.to_move);
+  rings.push_back(pos.board.rings);
+  for (int c = 0; c < kNumColors; ++c) {
+    balls[c].push_back(pos.board.balls[c]);
+    counts[kSupply][c].push_back(pos.supply[c]);
+    counts[kToMove][c].push_back(pos.captured[me][c]);
+    counts[kOpponent][c].push_back(pos.captured[1 - me][c]);
+  }
+  to_move.push_back(pos.to_move);
+  chain_cell.push_back(pos.chain_cell);
+}
+
+Position PositionBatch::Get(size_t i) const {
+  Position pos(variant);
+  int me = Index(to_move[i]);
+  pos.board.rings = rings[i];
+  for (int c = 0; c < kNumColors; ++c) {
+    pos.board.balls[c] = balls[c][i];
+    pos.supply[c] = counts[kSupply][c][i];
+    pos.captured[me][c] = counts[kToMove][c][i];
+    pos.captured[1 - me][c] = counts[kOpponent][c][i];
+  }
+  pos.to_move = to_move[i];
+  pos.chain_cell = chain_cell[i];
+  pos.hash = pos.ComputeHash();
+  return pos;
+}
+
+void Evaluator::EvaluateBatch(const PositionBatch& batch, int* scores) const {
+  for (size_t i = 0; i < batch.Size(); ++i) {
+    scores[i] = Evaluate(batch.Get(i));
+  }
+}
+
+void HeuristicEvaluator::EvaluateBatch(const PositionBatch& batch, int* scores) const {
+  const auto& own = batch.counts[PositionBatch::kToMove];
+  const auto& other = batch.counts[PositionBatch::kOpponent];
+  WithVariant(batch.variant, [&] (auto tag) {
+    Mask free[kBlock];
+    for (size_t begin = 0; begin < batch.Size(); begin += kBlock) {
+      size_t n = std::min(kBlock, batch.Size() - begin);
+      CountFreeRings<decltype(tag)::value>(batch, begin, n, free);
+      for (size_t i = 0; i < n; ++i) {
+        size_t k = begin + i;
+        int score = Progress(own[0][k], own[1][k], own[2][k]) -
+            Progress(other[0][k], other[1][k], other[2][k]);
+        score += kTempo * static_cast<int>(free[i] & 1);
+        scores[k] = std::clamp(score, -kMaxEval, kMaxEval);
+      }
+    }
+  });
+}
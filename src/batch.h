@@ -0,0 +1,40 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "position.h"
+
+// Many positions of one board in struct-of-arrays layout, for throughput
+// workloads such as labeling game records or scoring training data. Every
+// field is an array with one element per position, so a loop over the
+// batch reads only the fields it uses, densely, and vectorizes.
+//
+// Ball counts are stored from the point of view of the side to move, the
+// way the evaluators read them, so batch loops do not branch on the side.
+struct PositionBatch {
+  // Piles of `counts`.
+  static constexpr int kSupply = 0;
+  static constexpr int kToMove = 1;
+  static constexpr int kOpponent = 2;
+  static constexpr int kPiles = 3;
+
+  explicit PositionBatch(BoardVariant variant = BoardVariant::kRings37) : variant(variant) {}
+
+  size_t Size() const { return rings.size(); }
+
+  void Reserve(size_t n);
+  void Clear();
+
+  // The position must be on the board of the batch.
+  void Add(const Position& pos);
+  Position Get(size_t i) const;
+
+  BoardVariant variant;
+  std::vector<Mask> rings;
+  std::array<std::vector<Mask>, kNumColors> balls;
+  std::array<std::array<std::vector<uint8_t>, kNumColors>, kPiles> counts;
+  std::vector<PlayerId> to_move;
+  std::vector<int8_t> chain_cell;
+};
@@ -0,0 +1,136 @@
+// Search benchmark: time to depth and nodes/s of the engine on a fixed set
+// of positions, for 1, 2, 4, ... threads up to the given maximum. Speed-up
+// and nodes/s scaling are reported against the single-thread run, followed
+// by MCTS playouts/s for the same thread counts, and by evaluations/s of
+// positions one by one and as a batch (see batch.h).
+//
+// Usage: zertz_bench [depth] [max threads] [tt megabytes]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batch.h"
+#include "mcts.h"
+#include "movegen.h"
+#include "notation.h"
+#include "search.h"
+
+namespace {
+
+const char* kPositions[] = {
+  "37 ooooooooooooooooooooooooooooooooooooo 6/8/10 0/0/0 0/0/0 1",
+  "37 ooo.wooo.oooboooooooo..boooo.oooo.ooo 4/7/7 1/0/0 0/1/1 1",
+  "37 ..o.ooo..oowooowooooo...ogo..oo...bo. 1/3/6 2/1/1 1/3/2 2",
+};
+
+struct Totals {
+  uint64_t nodes = 0;
+  double seconds = 0.0;
+};
+
+Totals RunAll(int depth, int threads, size_t tt_megabytes) {
+  auto evaluator = std::make_shared<HeuristicEvaluator>();
+  Engine engine(evaluator, tt_megabytes, threads);
+  SearchLimits limits;
+  limits.depth = depth;
+
+  Totals totals;
+  for (const char* str : kPositions) {
+    auto pos = notation::PositionFromString(str);
+    engine.NewGame();
+    auto info = engine.Search(*pos, limits);
+    totals.nodes += info.nodes;
+    totals.seconds += info.seconds;
+    std::cout << "  " << notation::ToString(*pos, info.BestMove())
+              << " score " << info.score << " nodes " << info.nodes
+              << " time " << info.seconds << " s\n";
+  }
+  return totals;
+}
+
+// Positions of random games, deterministic.
+PositionBatch RandomPositions(size_t count) {
+  PositionBatch batch;
+  batch.Reserve(count);
+  std::mt19937 rng(1);
+  while (batch.Size() < count) {
+    Position pos;
+    MoveList moves;
+    GenerateMoves(pos, moves);
+    while (!moves.Empty() && !pos.Winner()) {
+      pos.MakeMove(moves[rng() % moves.Size()]);
+      batch.Add(pos);
+      moves.Clear();
+      GenerateMoves(pos, moves);
+    }
+  }
+  return batch;
+}
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+int main(int argc, char** argv) {
+  int depth = argc > 1 ? std::atoi(argv[1]) : 3;
+  int max_threads = argc > 2 ? std::atoi(argv[2])
+      : std::max(1u, std::thread::hardware_concurrency());
+  int tt_megabytes = argc > 3 ? std::atoi(argv[3]) : 64;
+  if (argc > 4 || depth <= 0 || max_threads <= 0 || tt_megabytes <= 0) {
+    std::cerr << "Usage: " << argv[0] << " [depth] [max threads] [tt megabytes]\n";
+    return 1;
+  }
+
+  Totals base;
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    std::cout << "threads " << threads << "\n";
+    Totals totals = RunAll(depth, threads, tt_megabytes);
+    uint64_t nps = static_cast<uint64_t>(totals.nodes / std::max(totals.seconds, 1e-9));
+    if (threads == 1) {
+      base = totals;
+    }
+    uint64_t base_nps = static_cast<uint64_t>(base.nodes / std::max(base.seconds, 1e-9));
+    std::cout << "threads " << threads << ": " << totals.nodes << " nodes, "
+              << totals.seconds << " s, " << nps << " nodes/s, speed-up "
+              << base.seconds / std::max(totals.seconds, 1e-9) << ", nodes/s scaling "
+              << static_cast<double>(nps) / std::max<uint64_t>(base_nps, 1) << "\n";
+  }
+
+  const int64_t kMctsMillis = 2000;
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    Mcts mcts(tt_megabytes, threads);
+    MctsLimits limits;
+    limits.time_ms = kMctsMillis;
+    auto info = mcts.Search(*notation::PositionFromString(kPositions[1]), limits);
+    std::cout << "mcts threads " << threads << ": " << info.playouts << " playouts, "
+              << info.PlayoutsPerSecond() << " playouts/s, " << info.nodes << " nodes\n";
+  }
+
+  const size_t kEvalPositions = 1 << 20;
+  auto batch = RandomPositions(kEvalPositions);
+  std::vector<Position> positions;
+  for (size_t i = 0; i < batch.Size(); ++i) {
+    positions.push_back(batch.Get(i));
+  }
+  HeuristicEvaluator evaluator;
+  std::vector<int> scores(batch.Size());
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < positions.size(); ++i) {
+    scores[i] = evaluator.Evaluate(positions[i]);
+  }
+  double single = Seconds(start);
+  start = std::chrono::steady_clock::now();
+  evaluator.EvaluateBatch(batch, scores.data());
+  double batched = Seconds(start);
+  std::cout << "eval: " << batch.Size() / std::max(single, 1e-9) << " positions/s, batch "
+            << batch.Size() / std::max(batched, 1e-9) << " positions/s\n";
+  return 0;
+}
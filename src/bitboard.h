@@ -0,0 +1,396 @@
+#pragma once
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+#include "structures.h"
+
+// Bitboards for the Zertz board. Every ring of every supported board fits
+// into a single 64-bit word: cells are numbered linearly (row by row in the
+// axial grid), and a board is a mask of present rings plus one occupancy mask
+// per ball color.
+
+using Mask = uint64_t;
+
+enum class BallColor { kWhite, kGrey, kBlack };
+
+constexpr int kNumColors = 3;
+
+enum class BoardVariant { kRings37, kRings48, kRings61 };
+
+// Shape and ball supply of every board variant. The board is the part of a
+// kGrid x kGrid axial square for which q + r lies in [kSMin, kSMax].
+template <BoardVariant V> struct BoardShape;
+
+template <> struct BoardShape<BoardVariant::kRings37> {
+  static constexpr int kGrid = 7, kSMin = 3, kSMax = 9;
+  static constexpr std::array<int, kNumColors> kSupply = {6, 8, 10};
+};
+
+template <> struct BoardShape<BoardVariant::kRings48> {
+  static constexpr int kGrid = 8, kSMin = 3, kSMax = 10;
+  static constexpr std::array<int, kNumColors> kSupply = {8, 10, 12};
+};
+
+template <> struct BoardShape<BoardVariant::kRings61> {
+  static constexpr int kGrid = 9, kSMin = 4, kSMax = 12;
+  static constexpr std::array<int, kNumColors> kSupply = {10, 12, 14};
+};
+
+template <BoardVariant V>
+using VariantTag = std::integral_constant<BoardVariant, V>;
+
+// Calls f(VariantTag<V>{}) for the runtime variant, so that f is instantiated
+// separately for every board with its compile-time tables.
+template <typename F>
+decltype(auto) WithVariant(BoardVariant variant, F&& f) {
+  switch (variant) {
+    case BoardVariant::kRings48:
+      return f(VariantTag<BoardVariant::kRings48>{});
+    case BoardVariant::kRings61:
+      return f(VariantTag<BoardVariant::kRings61>{});
+    case BoardVariant::kRings37:
+      break;
+  }
+  return f(VariantTag<BoardVariant::kRings37>{});
+}
+
+// Number of white, grey and black balls in the supply of each board.
+inline std::array<int, kNumColors> InitialSupply(BoardVariant variant) {
+  return WithVariant(variant, [] (auto tag) {
+    return BoardShape<decltype(tag)::value>::kSupply;
+  });
+}
+
+inline int PopCount(Mask m) { return __builtin_popcountll(m); }
+inline int LowestBit(Mask m) { assert(m); return __builtin_ctzll(m); }
+inline Mask Bit(int idx) { return Mask{1} << idx; }
+
+// The bits of m at the set bits of select, gathered into the low bits.
+inline Mask Pext(Mask m, Mask select) {
+#ifdef __BMI2__
+  return _pext_u64(m, select);
+#else
+  Mask out = 0;
+  for (Mask bit = 1; select; select &= select - 1, bit <<= 1) {
+    if (m & select & -select) {
+      out |= bit;
+    }
+  }
+  return out;
+#endif
+}
+
+// Inverse of Pext: the low bits of m scattered to the set bits of select.
+inline Mask Pdep(Mask m, Mask select) {
+#ifdef __BMI2__
+  return _pdep_u64(m, select);
+#else
+  Mask out = 0;
+  for (Mask bit = 1; select; select &= select - 1, bit <<= 1) {
+    if (m & bit) {
+      out |= select & -select;
+    }
+  }
+  return out;
+#endif
+}
+
+// Iterates over set bits: for (int i : SetBits{mask}) { ... }
+struct SetBits {
+  struct Iterator {
+    Mask m;
+    int operator*() const { return LowestBit(m); }
+    Iterator& operator++() { m &= m - 1; return *this; }
+    bool operator!=(const Iterator& other) const { return m != other.m; }
+  };
+
+  Mask mask;
+  Iterator begin() const { return {mask}; }
+  Iterator end() const { return {0}; }
+};
+
+constexpr int kNoCell = -1;
+constexpr int kNumDirections = 6;
+
+// Axial directions in cyclic order, so that directions d and (d + 1) % 6
+// are adjacent edges of a hexagon.
+constexpr std::array<QR, kNumDirections> kDirections = {{
+  {1, 0}, {1, -1}, {0, -1}, {-1, 0}, {-1, 1}, {0, 1}
+}};
+
+struct HexCenter {
+  float x = 0.0f;
+  float y = 0.0f;
+};
+
+namespace detail {
+
+template <BoardVariant V>
+constexpr bool OnBoard(int q, int r) {
+  using Shape = BoardShape<V>;
+  return q >= 0 && q < Shape::kGrid && r >= 0 && r < Shape::kGrid &&
+      q + r >= Shape::kSMin && q + r <= Shape::kSMax;
+}
+
+template <BoardVariant V>
+constexpr int CountCells() {
+  int n = 0;
+  for (int q = 0; q < BoardShape<V>::kGrid; ++q) {
+    for (int r = 0; r < BoardShape<V>::kGrid; ++r) {
+      n += OnBoard<V>(q, r);
+    }
+  }
+  return n;
+}
+
+template <BoardVariant V>
+constexpr auto MakeIndex() {
+  constexpr int kGrid = BoardShape<V>::kGrid;
+  std::array<int8_t, kGrid * kGrid> index{};
+  int n = 0;
+  for (int q = 0; q < kGrid; ++q) {
+    for (int r = 0; r < kGrid; ++r) {
+      index[q * kGrid + r] = OnBoard<V>(q, r) ? n++ : kNoCell;
+    }
+  }
+  return index;
+}
+
+template <BoardVariant V>
+constexpr auto MakeCells() {
+  std::array<QR, CountCells<V>()> cells{};
+  int n = 0;
+  for (int q = 0; q < BoardShape<V>::kGrid; ++q) {
+    for (int r = 0; r < BoardShape<V>::kGrid; ++r) {
+      if (OnBoard<V>(q, r)) {
+        cells[n++] = QR{q, r};
+      }
+    }
+  }
+  return cells;
+}
+
+template <BoardVariant V>
+constexpr auto MakeNeighbors() {
+  constexpr int kGrid = BoardShape<V>::kGrid;
+  constexpr auto kIndex = MakeIndex<V>();
+  constexpr auto kCells = MakeCells<V>();
+  std::array<std::array<int8_t, kNumDirections>, CountCells<V>()> neighbors{};
+  for (int i = 0; i < CountCells<V>(); ++i) {
+    for (int d = 0; d < kNumDirections; ++d) {
+      int q = kCells[i].q + kDirections[d].q;
+      int r = kCells[i].r + kDirections[d].r;
+      neighbors[i][d] = OnBoard<V>(q, r) ? kIndex[q * kGrid + r] : kNoCell;
+    }
+  }
+  return neighbors;
+}
+
+// Landing cell of a jump from the cell over its neighbor in direction d.
+template <BoardVariant V>
+constexpr auto MakeJumps() {
+  constexpr auto kNeighbors = MakeNeighbors<V>();
+  std::array<std::array<int8_t, kNumDirections>, CountCells<V>()> jumps{};
+  for (int i = 0; i < CountCells<V>(); ++i) {
+    for (int d = 0; d < kNumDirections; ++d) {
+      int over = kNeighbors[i][d];
+      jumps[i][d] = over == kNoCell ? kNoCell : kNeighbors[over][d];
+    }
+  }
+  return jumps;
+}
+
+// For each pair of adjacent edges (d, d + 1) of the cell, the rings that
+// touch them. The ring can be slid out if any of these masks has no rings.
+template <BoardVariant V>
+constexpr auto MakeFreeEdges() {
+  constexpr auto kNeighbors = MakeNeighbors<V>();
+  std::array<std::array<Mask, kNumDirections>, CountCells<V>()> edges{};
+  for (int i = 0; i < CountCells<V>(); ++i) {
+    for (int d = 0; d < kNumDirections; ++d) {
+      for (int n : {kNeighbors[i][d], kNeighbors[i][(d + 1) % kNumDirections]}) {
+        if (n != kNoCell) {
+          edges[i][d] |= Mask{1} << n;
+        }
+      }
+    }
+  }
+  return edges;
+}
+
+// Cell centers for hexes of unit radius (flat-topped layout).
+template <BoardVariant V>
+constexpr auto MakeCenters() {
+  constexpr float kSqrt3 = 1.7320508f;
+  constexpr auto kCells = MakeCells<V>();
+  std::array<HexCenter, CountCells<V>()> centers{};
+  for (int i = 0; i < CountCells<V>(); ++i) {
+    centers[i] = HexCenter{1.5f * kCells[i].q, kSqrt3 * (0.5f * kCells[i].q + kCells[i].r)};
+  }
+  return centers;
+}
+
+template <BoardVariant V>
+constexpr auto MakeNeighborMasks() {
+  constexpr auto kNeighbors = MakeNeighbors<V>();
+  std::array<Mask, CountCells<V>()> masks{};
+  for (int i = 0; i < CountCells<V>(); ++i) {
+    for (int d = 0; d < kNumDirections; ++d) {
+      if (kNeighbors[i][d] != kNoCell) {
+        masks[i] |= Mask{1} << kNeighbors[i][d];
+      }
+    }
+  }
+  return masks;
+}
+
+}  // namespace detail
+
+// Geometry of one board variant over linear cell indices, generated at
+// compile time. Loops over kNumCells and kNumDirections have fixed trip
+// counts in code instantiated for the variant.
+template <BoardVariant V>
+struct HexTables {
+  static constexpr int kGrid = BoardShape<V>::kGrid;
+  static constexpr int kNumCells = detail::CountCells<V>();
+  static_assert(kNumCells <= 64, "Board must fit into a 64-bit mask");
+
+  static constexpr Mask kAll = kNumCells == 64 ? ~Mask{0} : (Mask{1} << kNumCells) - 1;
+  // Linear index of grid cell (q, r) at q * kGrid + r, or kNoCell.
+  static constexpr auto kIndex = detail::MakeIndex<V>();
+  static constexpr auto kCells = detail::MakeCells<V>();
+  static constexpr auto kNeighbors = detail::MakeNeighbors<V>();
+  static constexpr auto kJumps = detail::MakeJumps<V>();
+  static constexpr auto kNeighborMask = detail::MakeNeighborMasks<V>();
+  static constexpr auto kFreeEdges = detail::MakeFreeEdges<V>();
+  static constexpr auto kCenters = detail::MakeCenters<V>();
+};
+
+// Runtime view of the tables of a variant, for code that is not
+// instantiated per board (GUI, notation, ZBoard).
+struct HexGeometry {
+  static constexpr int kMaxCells = 64;
+  static constexpr int kMaxGrid = 9;
+  static constexpr int kNoCell = ::kNoCell;
+  static constexpr int kNumDirections = ::kNumDirections;
+  static constexpr const std::array<QR, kNumDirections>& kDirections = ::kDirections;
+
+  bool InGrid(QR pos) const {
+    return pos.q >= 0 && pos.q < grid && pos.r >= 0 && pos.r < grid;
+  }
+
+  // Linear index of the cell or kNoCell if it is not a part of the board.
+  int IndexOf(QR pos) const {
+    return InGrid(pos) ? index[pos.q * kMaxGrid + pos.r] : kNoCell;
+  }
+
+  QR CellQR(int idx) const {
+    assert(idx >= 0 && idx < num_cells);
+    return cells[idx];
+  }
+
+  static const HexGeometry& Get(BoardVariant variant) {
+    static const HexGeometry kRings37 = Make<BoardVariant::kRings37>();
+    static const HexGeometry kRings48 = Make<BoardVariant::kRings48>();
+    static const HexGeometry kRings61 = Make<BoardVariant::kRings61>();
+    switch (variant) {
+      case BoardVariant::kRings37:
+        return kRings37;
+      case BoardVariant::kRings48:
+        return kRings48;
+      case BoardVariant::kRings61:
+        return kRings61;
+    }
+    return kRings37;
+  }
+
+  BoardVariant variant = BoardVariant::kRings37;
+  int grid = 0;
+  int num_cells = 0;
+  Mask all = 0;
+  std::array<int8_t, kMaxGrid * kMaxGrid> index;
+  std::array<QR, kMaxCells> cells;
+  std::array<std::array<int8_t, kNumDirections>, kMaxCells> neighbors;
+  std::array<std::array<int8_t, kNumDirections>, kMaxCells> jumps;
+  std::array<Mask, kMaxCells> neighbor_mask;
+  std::array<HexCenter, kMaxCells> centers;
+
+ private:
+  template <BoardVariant V>
+  static HexGeometry Make() {
+    using Tables = HexTables<V>;
+    HexGeometry g;
+    g.variant = V;
+    g.grid = Tables::kGrid;
+    g.num_cells = Tables::kNumCells;
+    g.all = Tables::kAll;
+    g.index.fill(kNoCell);
+    for (int q = 0; q < Tables::kGrid; ++q) {
+      for (int r = 0; r < Tables::kGrid; ++r) {
+        g.index[q * kMaxGrid + r] = Tables::kIndex[q * Tables::kGrid + r];
+      }
+    }
+    for (int i = 0; i < Tables::kNumCells; ++i) {
+      g.cells[i] = Tables::kCells[i];
+      g.neighbors[i] = Tables::kNeighbors[i];
+      g.jumps[i] = Tables::kJumps[i];
+      g.neighbor_mask[i] = Tables::kNeighborMask[i];
+      g.centers[i] = Tables::kCenters[i];
+    }
+    return g;
+  }
+};
+
+// Ring and ball occupancy of the board, without ball identities.
+struct BitBoard {
+  explicit BitBoard(const HexGeometry& geometry)
+    : geometry(&geometry), rings(geometry.all), balls{} {}
+
+  Mask Occupied() const { return balls[0] | balls[1] | balls[2]; }
+  Mask Vacant() const { return rings & ~Occupied(); }
+
+  BoardVariant Variant() const { return geometry->variant; }
+
+  bool HasRing(int idx) const { return rings & Bit(idx); }
+  bool HasBall(int idx) const { return Occupied() & Bit(idx); }
+
+  std::optional<BallColor> ColorAt(int idx) const {
+    for (int c = 0; c < kNumColors; ++c) {
+      if (balls[c] & Bit(idx)) {
+        return static_cast<BallColor>(c);
+      }
+    }
+    return std::nullopt;
+  }
+
+  void Place(int idx, BallColor color) {
+    assert(HasRing(idx) && !HasBall(idx));
+    balls[static_cast<int>(color)] |= Bit(idx);
+  }
+
+  void Clear(int idx, BallColor color) {
+    assert(balls[static_cast<int>(color)] & Bit(idx));
+    balls[static_cast<int>(color)] &= ~Bit(idx);
+  }
+
+  void RemoveRing(int idx) {
+    assert(HasRing(idx) && !HasBall(idx));
+    rings &= ~Bit(idx);
+  }
+
+  void RestoreRing(int idx) {
+    assert(!HasRing(idx));
+    rings |= Bit(idx);
+  }
+
+  const HexGeometry* geometry;
+  Mask rings;
+  std::array<Mask, kNumColors> balls;
+};
@@ -0,0 +1,125 @@
+#include "book.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include "movegen.h"
+#include "symmetry.h"
+
+namespace {
+
+constexpr char kMagic[4] = {'Z', 'B', 'K', '1'};
+
+struct Header {
+  char magic[4];
+  uint32_t reserved;
+  uint64_t size;
+};
+
+static_assert(sizeof(Header) == 16);
+
+// Below this many records binary search is as fast as interpolating.
+constexpr uint64_t kBinarySearchRecords = 16;
+
+}
+
+OpeningBook::OpeningBook(const std::string& path) : file_(path) {
+  Header header;
+  if (file_.Size() < sizeof(header)) {
+    throw std::runtime_error("Bad opening book " + path);
+  }
+  std::memcpy(&header, file_.Data(), sizeof(header));
+  size_ = header.size;
+  records_ = reinterpret_cast<const BookRecord*>(file_.Data() + sizeof(Header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      sizeof(Header) + size_ * sizeof(BookRecord) != file_.Size()) {
+    throw std::runtime_error("Bad opening book " + path);
+  }
+}
+
+std::optional<BookRecord> OpeningBook::Find(uint64_t key) const {
+  if (size_ == 0) {
+    return std::nullopt;
+  }
+  // Records in [lo, hi] may hold the key.
+  uint64_t lo = 0;
+  uint64_t hi = size_ - 1;
+  while (hi - lo >= kBinarySearchRecords) {
+    uint64_t lo_key = records_[lo].key;
+    uint64_t hi_key = records_[hi].key;
+    if (key < lo_key || key > hi_key) {
+      return std::nullopt;
+    }
+    // Keys are distinct, so hi_key > lo_key.
+    uint64_t mid = lo + static_cast<uint64_t>(
+        static_cast<unsigned __int128>(key - lo_key) * (hi - lo) / (hi_key - lo_key));
+    if (records_[mid].key < key) {
+      lo = mid + 1;
+    } else if (records_[mid].key > key) {
+      hi = mid - 1;
+    } else {
+      return records_[mid];
+    }
+  }
+  auto begin = records_ + lo;
+  auto end = records_ + hi + 1;
+  auto it = std::lower_bound(begin, end, key, [] (const BookRecord& record, uint64_t k) {
+    return record.key < k;
+  });
+  if (it != end && it->key == key) {
+    return *it;
+  }
+  return std::nullopt;
+}
+
+std::optional<BookRecord> OpeningBook::Find(const Position& pos) const {
+  return Find(CanonicalHash(pos));
+}
+
+std::optional<Move> OpeningBook::BestMove(const Position& pos, uint32_t min_games) const {
+  MoveList moves;
+  GenerateMoves(pos, moves);
+  std::optional<Move> best;
+  double best_score = -1.0;
+  uint32_t best_games = 0;
+  Position child = pos;
+  for (Move move : moves) {
+    auto undo = child.MakeMove(move);
+    auto record = Find(child);
+    // Records score the side to move of the child, which is still the
+    // mover during a capture chain.
+    bool same_side = child.to_move == pos.to_move;
+    child.UnmakeMove(move, undo);
+    if (!record || record->games < std::max(min_games, 1u)) {
+      continue;
+    }
+    double score = same_side ? record->Score() : 1.0 - record->Score();
+    if (score > best_score || (score == best_score && record->games > best_games)) {
+      best = move;
+      best_score = score;
+      best_games = record->games;
+    }
+  }
+  return best;
+}
+
+void WriteOpeningBook(const std::string& path, std::vector<BookRecord> records) {
+  std::sort(records.begin(), records.end(), [] (const BookRecord& left, const BookRecord& right) {
+    return left.key < right.key;
+  });
+  Header header{.reserved = 0, .size = records.size()};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+
+  FILE* file = std::fopen(path.c_str(), "wb");
+  if (!file) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+      std::fwrite(records.data(), sizeof(BookRecord), records.size(), file) == records.size();
+  ok = std::fclose(file) == 0 && ok;
+  if (!ok) {
+    throw std::runtime_error("Cannot write " + path);
+  }
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "position.h"
+
+// Opening book: game statistics of positions, keyed by their canonical hash
+// (see symmetry.h), so symmetric positions and transpositions share a record.
+//
+// File layout (little-endian): "ZBK1", u32 0, u64 number of records, then
+// records sorted by key:
+//   u64 key, u32 games through the position, u32 points of the side to
+//   move (2 per win, 1 per draw).
+// The keys are hashes and spread evenly, so lookups use interpolation
+// search and touch a few pages of the file.
+
+struct BookRecord {
+  uint64_t key = 0;
+  uint32_t games = 0;
+  uint32_t points = 0;
+
+  // Expected score of the side to move, in [0, 1].
+  double Score() const { return games ? points / (2.0 * games) : 0.5; }
+};
+
+static_assert(sizeof(BookRecord) == 16);
+
+// A book file mapped into memory, read-only and shared between processes.
+// Opening it only maps the file, and lookups do not allocate.
+class OpeningBook {
+ public:
+  // Throws std::runtime_error if the file cannot be mapped or is not a
+  // book.
+  explicit OpeningBook(const std::string& path);
+
+  uint64_t Size() const { return size_; }
+
+  std::optional<BookRecord> Find(uint64_t key) const;
+  std::optional<BookRecord> Find(const Position& pos) const;
+
+  // The move with the best score for the side to move among the positions
+  // reached by at least `min_games` games, ties going to the most games.
+  // Null if no move qualifies, so that the caller searches instead.
+  std::optional<Move> BestMove(const Position& pos, uint32_t min_games = kMinGames) const;
+
+  // Games below which a score is too noisy to pick a move by.
+  static constexpr uint32_t kMinGames = 10;
+
+ private:
+  MappedFile file_;
+  const BookRecord* records_ = nullptr;
+  uint64_t size_ = 0;
+};
+
+// Writes records in any order; they are sorted by key first.
+void WriteOpeningBook(const std::string& path, std::vector<BookRecord> records);
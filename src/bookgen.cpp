@@ -0,0 +1,92 @@
+// Opening book builder.
+//
+// Usage: zertz_book <output file> <record chunk>... [--plies N] [--min-games G]
+//
+// Replays the first N plies (default 24) of every game in the chunk files
+// (see game_record.h) and counts, for every position on the way, the games
+// that went through it and the points its side to move scored. Positions
+// reached by fewer than G games (default 2) are left out of the book.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "book.h"
+#include "game_record.h"
+#include "symmetry.h"
+
+namespace {
+
+struct Stats {
+  uint32_t games = 0;
+  uint32_t points = 0;
+};
+
+// Points of the side to move for the result of the game.
+uint32_t Points(GameRecord::Result result, PlayerId to_move) {
+  if (result == GameRecord::Result::kDraw) {
+    return 1;
+  }
+  auto winner = result == GameRecord::Result::kPlayer1 ? PlayerId::kPlayer1 : PlayerId::kPlayer2;
+  return winner == to_move ? 2 : 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+  int plies = 24;
+  uint32_t min_games = 2;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--plies") == 0 && i + 1 < argc) {
+      plies = std::atoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--min-games") == 0 && i + 1 < argc) {
+      min_games = std::strtoul(argv[++i], nullptr, 10);
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.size() < 2) {
+    std::cerr << "Usage: " << argv[0]
+              << " <output file> <record chunk>... [--plies N] [--min-games G]\n";
+    return 1;
+  }
+
+  std::unordered_map<uint64_t, Stats> stats;
+  uint64_t games = 0;
+  for (size_t i = 1; i < paths.size(); ++i) {
+    GameRecordReader reader(paths[i]);
+    if (!reader.IsOpen()) {
+      std::cerr << "Cannot read " << paths[i] << "\n";
+      return 1;
+    }
+    while (auto record = reader.Next()) {
+      ++games;
+      Position pos(record->variant);
+      int length = std::min<int>(plies, record->moves.size());
+      for (int ply = 0; ply <= length; ++ply) {
+        auto& entry = stats[CanonicalHash(pos)];
+        ++entry.games;
+        entry.points += Points(record->result, pos.to_move);
+        if (ply < length) {
+          pos.MakeMove(record->moves[ply]);
+        }
+      }
+    }
+  }
+
+  std::vector<BookRecord> records;
+  for (const auto& [key, entry] : stats) {
+    if (entry.games >= min_games) {
+      records.push_back(BookRecord{.key = key, .games = entry.games, .points = entry.points});
+    }
+  }
+  std::cout << games << " games, " << stats.size() << " positions, " << records.size()
+            << " in the book\n";
+  WriteOpeningBook(paths[0], std::move(records));
+  return 0;
+}
@@ -1,4 +1,6 @@
 #pragma once
+#include "engine_worker.h"
+#include "position.h"
 #include "zertz.h"
 
 // Controller is a bridge between the game backend and the GUI.
@@ -30,6 +32,10 @@ struct ZController {
   ZController(std::shared_ptr<Zertz> zertz) : zertz(zertz) {}
 
   ActionResult OnClick(ObjIndex idx) {
+    // The engine's move is replayed on the state it searched.
+    if (engine_thinking) {
+      return ActionResult::kFail;
+    }
     if (idx.type == ObjType::kUndoButton) {
       action.Clear();
       return UndoAction();
@@ -44,8 +50,72 @@ struct ZController {
       return ActionResult::kSelected;
     }
   }
+
+  // Lets the engine play `side`. The human ends a turn with EndTurn(), the
+  // engine answers through the same click path as the GUI and then ponders
+  // on the reply it expects.
+  void AttachEngine(std::shared_ptr<EngineWorker> worker, PlayerId side, SearchLimits limits) {
+    engine = std::move(worker);
+    engine_side = side;
+    engine_limits = limits;
+  }
+
+  void EndTurn() {
+    if (!engine || engine_thinking) {
+      return;
+    }
+    action.Clear();
+    StartEngine(Position::FromState(zertz->Latest(), engine_side));
+  }
+
+  bool EngineThinking() const { return engine_thinking; }
+
+  // Plays the move of a finished engine search. Returns true if the game
+  // state changed.
+  bool Update() {
+    if (!engine_thinking) {
+      return false;
+    }
+    auto result = engine->TakeResult();
+    if (!result) {
+      return false;
+    }
+    engine_thinking = false;
+    Move move = result->BestMove();
+    if (move == Move::None() || zertz->Version() != engine_version) {
+      return false;
+    }
+
+    // Not rebuilt from the state, which does not know about capture chains.
+    Position pos = engine_position;
+    PlayEngineMove(pos, move);
+    pos.MakeMove(move);
+    if (pos.to_move == engine_side) {
+      // The capture chain goes on.
+      StartEngine(pos);
+      return true;
+    }
+
+    // Ponder on the position after the expected reply, including the rest
+    // of its capture chain.
+    size_t ply = 1;
+    while (ply < result->pv.size() && pos.to_move != engine_side) {
+      pos.MakeMove(result->pv[ply++]);
+    }
+    if (pos.to_move == engine_side) {
+      engine->Ponder(pos);
+    }
+    return true;
+  }
   
  private:
+  void StartEngine(const Position& pos) {
+    engine_position = pos;
+    engine_version = zertz->Version();
+    engine->Go(pos, engine_limits);
+    engine_thinking = true;
+  }
+
   // Actual game logic below
   ActionResult ApplyAction() {
     switch(action.src->type) {
@@ -94,6 +164,65 @@ struct ZController {
     return is_success ? ActionResult::kSuccess : ActionResult::kFail;
   }
 
+  // Replays the engine move as GUI clicks on the position it was searched
+  // from, including taking off the isolated groups it claims.
+  void PlayEngineMove(const Position& pos, Move move) {
+    action.Clear();
+    const auto& state = zertz->Latest();
+    const auto& geometry = pos.Geometry();
+    PileId own = engine_side == PlayerId::kPlayer1 ? PileId::kPlayer1 : PileId::kPlayer2;
+    auto BallAt = [&] (int cell) { return *state.board.Hex(geometry.CellQR(cell)).ball_idx; };
+
+    if (move.IsCapture()) {
+      int from = move.From();
+      int over = geometry.neighbors[from][move.Direction()];
+      int land = geometry.jumps[from][move.Direction()];
+      int jumped = BallAt(over);
+      ClickPair(BallIndex(BallAt(from)), CellIndex(geometry.CellQR(land)));
+      ClickPair(BallIndex(jumped), PileIndex(own));
+      return;
+    }
+
+    const auto& source = state.GetPile(pos.SupplyEmpty() ? own : PileId::kTable);
+    for (int slot = 0; slot < source.Size(); ++slot) {
+      if (state.balls[source.At(slot)].color == move.Color()) {
+        ClickPair(BallIndex(source.At(slot)), CellIndex(geometry.CellQR(move.Cell())));
+        break;
+      }
+    }
+    Mask removed = 0;
+    if (move.RemovedRing() != Move::kNoRing) {
+      removed = Bit(move.RemovedRing());
+      auto qr = geometry.CellQR(move.RemovedRing());
+      ClickPair(CellIndex(qr), CellIndex(qr));
+    }
+    Position after = pos;
+    after.MakeMove(move);
+    for (int cell : SetBits{pos.board.rings & ~after.board.rings & ~removed}) {
+      auto qr = geometry.CellQR(cell);
+      ClickPair(BallIndex(BallAt(cell)), PileIndex(own));
+      ClickPair(CellIndex(qr), CellIndex(qr));
+    }
+  }
+
+  void ClickPair(ObjIndex src, ObjIndex dst) {
+    OnClick(src);
+    OnClick(dst);
+  }
+
+  static ObjIndex BallIndex(BallId id) { return ObjIndex{.type = ObjType::kBall, .ball_id = id}; }
+  static ObjIndex CellIndex(QR qr) { return ObjIndex{.type = ObjType::kCell, .qr = qr}; }
+  static ObjIndex PileIndex(PileId id) { return ObjIndex{.type = ObjType::kPile, .pile_id = id}; }
+
   std::shared_ptr<Zertz> zertz;
   Action action;
+
+  std::shared_ptr<EngineWorker> engine;
+  PlayerId engine_side = PlayerId::kPlayer2;
+  SearchLimits engine_limits;
+  bool engine_thinking = false;
+  // Position of the running search and the version of the state it was
+  // taken from.
+  Position engine_position;
+  uint64_t engine_version = 0;
 };
\ No newline at end of file
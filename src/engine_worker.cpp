@@ -0,0 +1,216 @@
+#include "engine_worker.h"
+
+#include <algorithm>
+
+namespace {
+
+const auto kStopRetry = std::chrono::milliseconds(10);
+
+}
+
+EngineWorker::EngineWorker(std::shared_ptr<const Evaluator> evaluator, size_t tt_megabytes,
+                           int threads)
+  : engine_(std::move(evaluator), tt_megabytes, threads)
+  , control_thread_([this] { ControlLoop(); }) {}
+
+EngineWorker::~EngineWorker() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  cv_.notify_all();
+  control_thread_.join();
+}
+
+void EngineWorker::Go(const Position& pos, const SearchLimits& limits) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  result_.reset();
+  // The ponder search runs without limits and only a deadline can be set
+  // on it later; searches with depth or node limits start over, with the
+  // tables the ponder search filled.
+  bool time_limit_only = limits.depth == SearchLimits{}.depth && limits.nodes == 0;
+  if (pondering_ && !pending_ && pos.hash == ponder_hash_ && time_limit_only) {
+    // Ponder hit: keep the search and its tables, limit the remaining time.
+    pondering_ = false;
+    if (ponder_result_) {
+      result_ = std::move(ponder_result_);
+      ponder_result_.reset();
+      lock.unlock();
+      Notify();
+      return;
+    }
+    if (limits.time_ms > 0) {
+      deadline_ = ponder_start_ + std::chrono::milliseconds(limits.time_ms);
+    }
+  } else {
+    pending_ = Request{.pos = pos, .limits = limits, .ponder = false};
+    SetActive(true);
+  }
+  lock.unlock();
+  cv_.notify_all();
+}
+
+void EngineWorker::Ponder(const Position& pos) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ = Request{.pos = pos, .limits = SearchLimits{}, .ponder = true};
+    SetActive(true);
+  }
+  cv_.notify_all();
+}
+
+void EngineWorker::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.reset();
+    if (searching_) {
+      deadline_ = Clock::now();
+    } else {
+      SetActive(false);
+    }
+  }
+  cv_.notify_all();
+}
+
+std::optional<SearchInfo> EngineWorker::TakeResult() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto result = std::move(result_);
+  result_.reset();
+  return result;
+}
+
+EngineProgress EngineWorker::Progress() const {
+  EngineProgress progress;
+  while (true) {
+    uint32_t sequence = sequence_.load(std::memory_order_acquire);
+    if (sequence & 1) {
+      continue;
+    }
+    progress.version = sequence / 2;
+    progress.pondering = progress_pondering_.load(std::memory_order_relaxed);
+    progress.depth = progress_depth_.load(std::memory_order_relaxed);
+    progress.score = progress_score_.load(std::memory_order_relaxed);
+    progress.nodes = progress_nodes_.load(std::memory_order_relaxed);
+    progress.pv_length = progress_pv_length_.load(std::memory_order_relaxed);
+    for (int i = 0; i < progress.pv_length; ++i) {
+      progress.pv[i] = Move::FromRaw(progress_pv_[i].load(std::memory_order_relaxed));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence_.load(std::memory_order_relaxed) == sequence) {
+      return progress;
+    }
+  }
+}
+
+void EngineWorker::ControlLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!quit_) {
+    if (deadline_ && Clock::now() >= *deadline_) {
+      deadline_.reset();
+      // The search thread publishes what it has found so far.
+      StopSearch(lock);
+      continue;
+    }
+    if (!pending_) {
+      // Woken by requests; the deadline may have changed meanwhile.
+      if (deadline_) {
+        cv_.wait_until(lock, *deadline_);
+      } else {
+        cv_.wait(lock);
+      }
+      continue;
+    }
+
+    StopSearch(lock);
+    // Stop may have dropped the request while the old search was joined.
+    if (!pending_) {
+      continue;
+    }
+    Request request = std::move(*pending_);
+    pending_.reset();
+    deadline_.reset();
+    // Whatever the stopped search published is superseded.
+    ponder_result_.reset();
+    result_.reset();
+    searching_ = true;
+    pondering_ = request.ponder;
+    if (request.ponder) {
+      ponder_hash_ = request.pos.hash;
+      ponder_start_ = Clock::now();
+    }
+    search_thread_ = std::thread([this, request = std::move(request)] { RunSearch(request); });
+  }
+  StopSearch(lock);
+}
+
+void EngineWorker::StopSearch(std::unique_lock<std::mutex>& lock) {
+  while (searching_) {
+    engine_.Stop();
+    cv_.wait_for(lock, kStopRetry);
+  }
+  if (search_thread_.joinable()) {
+    lock.unlock();
+    search_thread_.join();
+    lock.lock();
+  }
+}
+
+void EngineWorker::RunSearch(Request request) {
+  auto info = engine_.Search(request.pos, request.limits, [this] (const SearchInfo& info) {
+    bool pondering;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pondering = pondering_;
+    }
+    Publish(info, pondering);
+    Notify();
+  });
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pondering_) {
+      ponder_result_ = std::move(info);
+    } else {
+      result_ = std::move(info);
+    }
+    searching_ = false;
+    // Told while still active, so that the GUI cannot stop counting the
+    // worker as a redraw source before it sees the result.
+    Notify();
+    if (!pending_) {
+      SetActive(false);
+    }
+  }
+  cv_.notify_all();
+}
+
+void EngineWorker::SetActive(bool active) {
+  if (active_ != active) {
+    active_ = active;
+    if (activity_listener_) {
+      activity_listener_(active);
+    }
+  }
+}
+
+void EngineWorker::Publish(const SearchInfo& info, bool pondering) {
+  uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+  sequence_.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  progress_pondering_.store(pondering, std::memory_order_relaxed);
+  progress_depth_.store(info.depth, std::memory_order_relaxed);
+  progress_score_.store(info.score, std::memory_order_relaxed);
+  progress_nodes_.store(info.nodes, std::memory_order_relaxed);
+  int pv_length = std::min<int>(info.pv.size(), EngineProgress::kMaxPv);
+  for (int i = 0; i < pv_length; ++i) {
+    progress_pv_[i].store(info.pv[i].Raw(), std::memory_order_relaxed);
+  }
+  progress_pv_length_.store(pv_length, std::memory_order_relaxed);
+  sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+void EngineWorker::Notify() const {
+  if (listener_) {
+    listener_();
+  }
+}
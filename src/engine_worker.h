@@ -0,0 +1,125 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "search.h"
+
+// Latest completed iteration of the running search.
+struct EngineProgress {
+  static constexpr int kMaxPv = 16;
+
+  // Incremented with every published iteration.
+  uint32_t version = 0;
+  bool pondering = false;
+  int depth = 0;
+  int score = 0;
+  uint64_t nodes = 0;
+  int pv_length = 0;
+  std::array<Move, kMaxPv> pv{};
+};
+
+// Runs the engine in the background, so that callers (the GUI) never block
+// on a search. Go and Ponder start a new search and stop the current one;
+// Stop ends it early. The result of Go is picked up with TakeResult, the
+// progress of any search with Progress, and the listener is told whenever
+// either of them changes.
+class EngineWorker {
+ public:
+  using Listener = std::function<void()>;
+  using Clock = std::chrono::steady_clock;
+
+  EngineWorker(std::shared_ptr<const Evaluator> evaluator, size_t tt_megabytes = 64,
+               int threads = 1);
+  ~EngineWorker();
+
+  // Called from the worker threads, possibly with the worker's mutex held,
+  // so it must not call back into the worker. Must be set before the first
+  // search.
+  void SetListener(Listener listener) { listener_ = std::move(listener); }
+
+  // Called with true when Go or Ponder queues a search, from the calling
+  // thread, and with false once no search is running or queued, after
+  // the listener hears of the result. Must be set before the first search.
+  void SetActivityListener(std::function<void(bool)> listener) {
+    activity_listener_ = std::move(listener);
+  }
+
+  // Searches the position within the limits. If the worker is pondering on
+  // the same position and the limits are a time budget only, that search
+  // goes on and only the rest of the budget, counted from the start of
+  // pondering, is spent.
+  void Go(const Position& pos, const SearchLimits& limits);
+
+  // Searches the position without limits until the next Go or Stop, e.g.
+  // the position after the expected reply of the opponent.
+  void Ponder(const Position& pos);
+
+  // Ends the current search. A Go search still publishes its result.
+  void Stop();
+
+  // Result of the last Go search, returned once.
+  std::optional<SearchInfo> TakeResult();
+
+  // Consistent snapshot of the latest iteration. Lock-free, so it can be
+  // read on every frame.
+  EngineProgress Progress() const;
+
+ private:
+  struct Request {
+    Position pos;
+    SearchLimits limits;
+    bool ponder = false;
+  };
+
+  void ControlLoop();
+  void RunSearch(Request request);
+  // Stops the running search and waits for its thread. Stop requests that
+  // reach the engine before the search has started are lost, so they are
+  // repeated until the search thread reports back.
+  void StopSearch(std::unique_lock<std::mutex>& lock);
+  // Reports changes of `active_` to the activity listener. Needs mutex_.
+  void SetActive(bool active);
+  void Publish(const SearchInfo& info, bool pondering);
+  void Notify() const;
+
+  Engine engine_;
+  Listener listener_;
+  std::function<void(bool)> activity_listener_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::optional<Request> pending_;
+  bool quit_ = false;
+  bool searching_ = false;
+  bool pondering_ = false;
+  // A search is running or queued.
+  bool active_ = false;
+  uint64_t ponder_hash_ = 0;
+  Clock::time_point ponder_start_;
+  // When the running search must be stopped, set by Stop and ponder hits.
+  std::optional<Clock::time_point> deadline_;
+  // A ponder search that ended by itself, kept for a ponder hit.
+  std::optional<SearchInfo> ponder_result_;
+  std::optional<SearchInfo> result_;
+  std::thread search_thread_;
+  std::thread control_thread_;
+
+  // Progress is published under a sequence lock: odd while being written.
+  // Only the search thread writes and all fields are atomics, so readers
+  // retry instead of locking.
+  std::atomic<uint32_t> sequence_{0};
+  std::atomic<bool> progress_pondering_{false};
+  std::atomic<int> progress_depth_{0};
+  std::atomic<int> progress_score_{0};
+  std::atomic<uint64_t> progress_nodes_{0};
+  std::atomic<int> progress_pv_length_{0};
+  std::array<std::atomic<uint16_t>, EngineProgress::kMaxPv> progress_pv_{};
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include <algorithm>
+#include <memory>
+
+#include "movegen.h"
+#include "position.h"
+
+struct PositionBatch;
+
+// Scores are from the point of view of the side to move. Won positions are
+// scored kWinScore - ply, so that faster wins are preferred; evaluations
+// must stay below kMaxEval.
+constexpr int kWinScore = 30000;
+constexpr int kMaxPly = 96;
+constexpr int kMaxEval = kWinScore - 2 * kMaxPly;
+constexpr int kInfinity = kWinScore + 1;
+
+inline bool IsWinScore(int score) {
+  return score > kMaxEval || score < -kMaxEval;
+}
+
+// Evaluation state of one search thread that follows the search path, for
+// evaluators that update their inputs incrementally. The search pushes the
+// position after every move and pops it when the move is taken back.
+class EvalStack {
+ public:
+  virtual ~EvalStack() = default;
+
+  virtual void Reset(const Position& pos) = 0;
+  virtual void Push(const Position& pos) = 0;
+  virtual void Pop() = 0;
+
+  // Same as Evaluator::Evaluate for the last pushed position, `pos`.
+  virtual int Evaluate(const Position& pos) = 0;
+};
+
+class Evaluator {
+ public:
+  virtual ~Evaluator() = default;
+
+  // Static score of a position that is not finished.
+  virtual int Evaluate(const Position& pos) const = 0;
+
+  // State for one search thread, or null if Evaluate needs none.
+  virtual std::unique_ptr<EvalStack> NewStack() const { return nullptr; }
+
+  // Writes Evaluate of every position of the batch (see batch.h) to
+  // scores[0, batch.Size()). The default evaluates them one by one.
+  virtual void EvaluateBatch(const PositionBatch& batch, int* scores) const;
+};
+
+// Hand-written evaluation: progress of each player toward the closest win
+// condition, plus a small tempo term for the parity of free rings.
+class HeuristicEvaluator : public Evaluator {
+ public:
+  int Evaluate(const Position& pos) const override {
+    int me = Index(pos.to_move);
+    int score = Progress(pos.captured[me]) - Progress(pos.captured[1 - me]);
+    // Every placement takes one free ring away; with an odd number of them
+    // the side to move is the one to take the last.
+    if (PopCount(FreeRings(pos.board)) % 2 == 1) {
+      score += kTempo;
+    }
+    return std::clamp(score, -kMaxEval, kMaxEval);
+  }
+
+  // Vectorized over the positions, in batch.cpp.
+  void EvaluateBatch(const PositionBatch& batch, int* scores) const override;
+
+ private:
+  static constexpr int kTempo = 15;
+
+  static int Progress(const Position::Counts& c) { return Progress(c[0], c[1], c[2]); }
+
+  // Scaled so that the last ball of a condition is worth the most. Plain
+  // integer arithmetic without tables, so that batch loops vectorize it.
+  static int Progress(int white, int grey, int black) {
+    int parts[kNumColors] = {1000 * white / 4, 1000 * grey / 5, 1000 * black / 6};
+    int best = std::max({parts[0], parts[1], parts[2]});
+    int total = parts[0] + parts[1] + parts[2];
+    int each = 1000 * std::min({white, grey, black, 3}) / 3;
+    best = std::max(best, each);
+    // Squared, so that one condition close to completion beats several
+    // conditions that are half done.
+    return best * best / 1000 + total / 10;
+  }
+};
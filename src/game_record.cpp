@@ -0,0 +1,138 @@
+#include "game_record.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace {
+
+const char kMagic[4] = {'Z', 'G', 'R', '1'};
+const size_t kHeaderBytes = 8;
+
+void Put16(std::vector<uint8_t>& out, uint16_t value) {
+  out.push_back(value & 0xFF);
+  out.push_back(value >> 8);
+}
+
+uint16_t Get16(const uint8_t* in) {
+  return in[0] | (in[1] << 8);
+}
+
+bool FileExists(const std::string& path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+}
+
+std::string ChunkPath(const std::string& prefix, int chunk_idx) {
+  char suffix[16];
+  std::snprintf(suffix, sizeof(suffix), "-%05d.zgr", chunk_idx);
+  return prefix + suffix;
+}
+
+GameRecordWriter::GameRecordWriter(std::string prefix, size_t chunk_bytes)
+  : prefix_(std::move(prefix))
+  , chunk_bytes_(chunk_bytes) {
+  buffer_.reserve(kBufferBytes + (1 << 16));
+  // Never touch chunks of earlier runs with the same prefix.
+  while (FileExists(ChunkPath(prefix_, chunk_idx_))) {
+    ++chunk_idx_;
+  }
+}
+
+GameRecordWriter::~GameRecordWriter() {
+  Flush();
+  if (file_) {
+    std::fclose(file_);
+  }
+}
+
+void GameRecordWriter::Append(const GameRecord& record) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Put16(buffer_, static_cast<uint16_t>(record.moves.size()));
+  buffer_.push_back(static_cast<uint8_t>(record.variant));
+  buffer_.push_back(static_cast<uint8_t>(record.result));
+  Put16(buffer_, record.seed & 0xFFFF);
+  Put16(buffer_, record.seed >> 16);
+  for (Move move : record.moves) {
+    Put16(buffer_, move.Raw());
+  }
+  if (buffer_.size() >= kBufferBytes) {
+    FlushLocked();
+  }
+}
+
+void GameRecordWriter::Flush() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  FlushLocked();
+}
+
+void GameRecordWriter::FlushLocked() {
+  if (buffer_.empty()) {
+    return;
+  }
+  if (!file_ || chunk_size_ >= chunk_bytes_) {
+    OpenChunk();
+  }
+  std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+  std::fflush(file_);
+  chunk_size_ += buffer_.size();
+  bytes_written_ += buffer_.size();
+  buffer_.clear();
+}
+
+void GameRecordWriter::OpenChunk() {
+  if (file_) {
+    std::fclose(file_);
+    ++chunk_idx_;
+  }
+  auto path = ChunkPath(prefix_, chunk_idx_);
+  file_ = std::fopen(path.c_str(), "ab");
+  if (!file_) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  std::fwrite(kMagic, 1, sizeof(kMagic), file_);
+  chunk_size_ = sizeof(kMagic);
+}
+
+GameRecordReader::GameRecordReader(const std::string& path) {
+  file_ = std::fopen(path.c_str(), "rb");
+  char magic[4];
+  if (file_ && (std::fread(magic, 1, sizeof(magic), file_) != sizeof(magic) ||
+                std::memcmp(magic, kMagic, sizeof(magic)) != 0)) {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+GameRecordReader::~GameRecordReader() {
+  if (file_) {
+    std::fclose(file_);
+  }
+}
+
+std::optional<GameRecord> GameRecordReader::Next() {
+  if (!file_) {
+    return std::nullopt;
+  }
+  uint8_t header[kHeaderBytes];
+  if (std::fread(header, 1, kHeaderBytes, file_) != kHeaderBytes) {
+    return std::nullopt;
+  }
+  GameRecord record;
+  int num_moves = Get16(header);
+  record.variant = static_cast<BoardVariant>(header[2]);
+  record.result = static_cast<GameRecord::Result>(header[3]);
+  record.seed = Get16(header + 4) | (uint32_t{Get16(header + 6)} << 16);
+
+  std::vector<uint8_t> data(2 * num_moves);
+  if (std::fread(data.data(), 1, data.size(), file_) != data.size()) {
+    return std::nullopt;
+  }
+  record.moves.reserve(num_moves);
+  for (int i = 0; i < num_moves; ++i) {
+    record.moves.push_back(Move::FromRaw(Get16(data.data() + 2 * i)));
+  }
+  return record;
+}
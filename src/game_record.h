@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "position.h"
+
+// Binary game records. Games are appended to chunk files
+// "<prefix>-00000.zgr", "<prefix>-00001.zgr", ... Every chunk starts with
+// the 4-byte magic "ZGR1", followed by records:
+//   u16 number of moves, u8 board variant, u8 result, u32 seed,
+//   then one u16 (Move::Raw) per move.
+// All integers are little-endian.
+
+struct GameRecord {
+  enum class Result : uint8_t { kPlayer1, kPlayer2, kDraw };
+
+  BoardVariant variant = BoardVariant::kRings37;
+  Result result = Result::kDraw;
+  uint32_t seed = 0;
+  std::vector<Move> moves;
+};
+
+// Thread-safe appender. Records are buffered and written in large blocks;
+// a new chunk is started once the current one exceeds the size limit.
+class GameRecordWriter {
+ public:
+  GameRecordWriter(std::string prefix, size_t chunk_bytes);
+  ~GameRecordWriter();
+
+  void Append(const GameRecord& record);
+  void Flush();
+
+  uint64_t BytesWritten() const { return bytes_written_.load(std::memory_order_relaxed); }
+
+ private:
+  void FlushLocked();
+  void OpenChunk();
+
+  static constexpr size_t kBufferBytes = 1 << 20;
+
+  const std::string prefix_;
+  const size_t chunk_bytes_;
+  std::mutex mutex_;
+  std::vector<uint8_t> buffer_;
+  std::FILE* file_ = nullptr;
+  int chunk_idx_ = 0;
+  size_t chunk_size_ = 0;
+  std::atomic<uint64_t> bytes_written_{0};
+};
+
+// Sequential reader of one chunk file.
+class GameRecordReader {
+ public:
+  explicit GameRecordReader(const std::string& path);
+  ~GameRecordReader();
+
+  bool IsOpen() const { return file_ != nullptr; }
+
+  // Next record, nullopt at the end of the file or on a truncated record.
+  std::optional<GameRecord> Next();
+
+ private:
+  std::FILE* file_ = nullptr;
+};
+
+std::string ChunkPath(const std::string& prefix, int chunk_idx);
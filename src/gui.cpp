@@ -11,12 +11,9 @@ const sf::Vector2f kUndoButtonPos = sf::Vector2f(700.0f, 100.0f);
 const sf::Vector2f kUndoButtonSize = sf::Vector2f(200.0f, 100.0f);
 
 
-sf::Vector2f QRCenterOffset(QR pos, float radius) {
-  float sq3 = std::sqrt(3.0f);
-  float sq32 = sq3 / 2.0f;
-  float x = radius * (3.0f/2 * pos.q);
-  float y = radius * (sq32 * pos.q + sq3 * pos.r);
-  return sf::Vector2f(x, y);
+sf::Vector2f CellCenterOffset(const HexGeometry& geometry, int cell, float radius) {
+  const auto& center = geometry.centers[cell];
+  return sf::Vector2f(radius * center.x, radius * center.y);
 }
 
 std::vector<sf::Vector2f> MakeHexVertices(float rad) {
@@ -47,6 +44,109 @@ float GetBallXOffset(int index_in_pile) {
   return (1 + index_in_pile) * 2.2f * kBallRadius;
 }
 
+sf::Color HexFillColor(QR pos) {
+  switch (std::abs(100 + pos.r - pos.q) % 3) {
+    case 0:
+      return sf::Color(50, 250, 150);
+    case 1:
+      return sf::Color(70, 200, 150);
+    default:
+      return sf::Color(60, 220, 170);
+  }
+}
+
+sf::Color BallFillColor(Ball::Color color) {
+  switch (color) {
+    case Ball::Color::kBlack:
+      return sf::Color(50, 50, 50);
+    case Ball::Color::kWhite:
+      return sf::Color(255, 255, 255);
+    case Ball::Color::kGrey:
+      return sf::Color(150, 150, 150);
+  }
+  return sf::Color::Magenta;
+}
+
+sf::Color PileFillColor(PileId pile_id) {
+  switch (pile_id) {
+    case PileId::kPlayer1:
+      return sf::Color(100, 220, 100);
+    case PileId::kPlayer2:
+      return sf::Color(50, 100, 200);
+    case PileId::kTable:
+      return sf::Color(200, 100, 100);
+  }
+  return sf::Color::Magenta;
+}
+
+sf::Vector2f PileCenter(PileId pile_id) {
+  return kPilesBase + sf::Vector2f(0.0f, GetPileYOffset(pile_id));
+}
+
+sf::Vector2f BallCenter(const ZState& state, int idx) {
+  auto& ball = state.balls[idx];
+  if (ball.OnBoard()) {
+    const auto& geometry = state.board.Geometry();
+    return kBoardBase + CellCenterOffset(geometry, geometry.IndexOf(ball.GetQR()), kCellSize);
+  }
+  auto pile_id = ball.GetPile();
+  auto index_in_pile = state.GetPile(pile_id).GetIndex(idx);
+  assert(index_in_pile);
+  return kPilesBase + sf::Vector2f(GetBallXOffset(*index_in_pile), GetPileYOffset(pile_id));
+}
+
+// Inverse of CellCenterOffset: the hex under the offset, found by rounding
+// fractional cube coordinates.
+QR OffsetToQR(sf::Vector2f offset, float radius) {
+  float q = offset.x / (1.5f * radius);
+  float r = offset.y / (std::sqrt(3.0f) * radius) - q / 2.0f;
+  float s = -q - r;
+  float round_q = std::round(q);
+  float round_r = std::round(r);
+  float round_s = std::round(s);
+  float dq = std::abs(round_q - q);
+  float dr = std::abs(round_r - r);
+  float ds = std::abs(round_s - s);
+  if (dq > dr && dq > ds) {
+    round_q = -round_r - round_s;
+  } else if (dr > ds) {
+    round_r = -round_q - round_s;
+  }
+  return QR{static_cast<int>(round_q), static_cast<int>(round_r)};
+}
+
+bool InCircle(sf::Vector2f point, sf::Vector2f center, float radius) {
+  float dx = point.x - center.x;
+  float dy = point.y - center.y;
+  return dx * dx + dy * dy < radius * radius;
+}
+
+// Appends a convex polygon as a triangle fan unrolled into triangles.
+void AppendPolygon(sf::VertexArray& vertices, sf::Vector2f center,
+                   const std::vector<sf::Vector2f>& outline, sf::Color color) {
+  for (size_t i = 0; i < outline.size(); ++i) {
+    vertices.append(sf::Vertex(center, color));
+    vertices.append(sf::Vertex(center + outline[i], color));
+    vertices.append(sf::Vertex(center + outline[(i + 1) % outline.size()], color));
+  }
+}
+
+void AppendRect(sf::VertexArray& vertices, sf::Vector2f pos, sf::Vector2f size, sf::Color color) {
+  sf::Vector2f half(size.x / 2.0f, size.y / 2.0f);
+  AppendPolygon(vertices, pos + half,
+                {{-half.x, -half.y}, {half.x, -half.y}, {half.x, half.y}, {-half.x, half.y}},
+                color);
+}
+
+std::vector<sf::Vector2f> MakeCircleVertices(float radius, int segments) {
+  std::vector<sf::Vector2f> v;
+  for (int i = 0; i < segments; ++i) {
+    float angle = 2.0f * 3.14159265f * i / segments;
+    v.emplace_back(radius * std::cos(angle), radius * std::sin(angle));
+  }
+  return v;
+}
+
 }
 
 bool Drawable::IsHovered(const sf::Vector2f& mouse_ndc) const {
@@ -86,11 +186,11 @@ std::unique_ptr<sf::Shape> MakeShape(float radius) {
   return shape; 
 }
 
-HexDrawable::HexDrawable(QR pos) 
+HexDrawable::HexDrawable(const HexGeometry& geometry, int cell)
   : Drawable(MakeShape(kCellSize), kCellSize)
   , radius(kCellSize)
-  , pos(pos) {
-  center = kBoardBase + QRCenterOffset(pos, kCellSize);
+  , pos(geometry.CellQR(cell)) {
+  center = kBoardBase + CellCenterOffset(geometry, cell, kCellSize);
   shape->setPosition(center);
 }
 
@@ -101,15 +201,7 @@ void HexDrawable::Draw(sf::RenderWindow& win, float time, const ZState& state) {
   }
   
   SetOutline(time);
-
-  if (std::abs(100 + pos.r - pos.q) % 3 == 0) {
-    shape->setFillColor(sf::Color(50, 250, 150));
-  } else if (std::abs(100 + pos.r - pos.q) % 3 == 1) {
-    shape->setFillColor(sf::Color(70, 200, 150));
-  } else {
-    shape->setFillColor(sf::Color(60, 220, 170));
-  }
-  
+  shape->setFillColor(HexFillColor(pos));
   shape->setPosition(center);
   win.draw(*shape);
 }
@@ -131,33 +223,11 @@ void BallDrawable::Draw(sf::RenderWindow& win, float time, const ZState& state)
 }
 
 void BallDrawable::SetColor(const ZState& state) {
-  auto& ball = state.balls[idx];
-  switch (ball.color) {
-    case Ball::Color::kBlack:
-      shape->setFillColor(sf::Color(50, 50, 50));
-      break;
-    case Ball::Color::kWhite:
-      shape->setFillColor(sf::Color(255, 255, 255));
-      break;
-    case Ball::Color::kGrey:
-      shape->setFillColor(sf::Color(150, 150, 150));
-      break;
-  }
+  shape->setFillColor(BallFillColor(state.balls[idx].color));
 }
 
 void BallDrawable::SetPositon(const ZState& state) {
-  auto& ball = state.balls[idx];
-  if (ball.OnBoard()) {
-    center = kBoardBase + QRCenterOffset(ball.GetQR(), kCellSize);
-  } else {
-    auto pile_id = ball.GetPile();
-    const auto& pile = state.piles.at(pile_id);
-    auto index_in_pile = pile.GetIndex(idx);
-    assert(index_in_pile);
-    center = kPilesBase + sf::Vector2f(
-        GetBallXOffset(*index_in_pile), 
-        GetPileYOffset(pile_id));
-  }
+  center = BallCenter(state, idx);
   shape->setPosition(center);
 }
 
@@ -167,10 +237,11 @@ PileDrawable::PileDrawable(PileId idx)
         kBallRadius)
   , idx(idx)  {
   shape->setOrigin(kBallRadius, kBallRadius);
+  center = PileCenter(idx);
 }
 
 void PileDrawable::Draw(sf::RenderWindow& win, float time, const ZState& state) {
-  center = kPilesBase + sf::Vector2f(0.0f, GetPileYOffset(idx));
+  center = PileCenter(idx);
   shape->setPosition(center);
   SetOutline(time);
   SetColor();
@@ -178,17 +249,7 @@ void PileDrawable::Draw(sf::RenderWindow& win, float time, const ZState& state)
 }
 
 void PileDrawable::SetColor() {
-  switch (idx) {
-    case PileId::kPlayer1:
-      shape->setFillColor(sf::Color(100, 220, 100));
-      break;
-    case PileId::kPlayer2:
-      shape->setFillColor(sf::Color(50, 100, 200));
-      break;
-    case PileId::kTable:
-      shape->setFillColor(sf::Color(200, 100, 100));
-      break;
-  }
+  shape->setFillColor(PileFillColor(idx));
 }
 
 
@@ -202,9 +263,122 @@ bool UndoButtonDrawable::IsHovered(const sf::Vector2f& mouse_pos) const {
       mouse_pos.y < kUndoButtonPos.y + kUndoButtonSize.y;
 }
 
+Bounds UndoButtonDrawable::GetBounds() const {
+  return Bounds{kUndoButtonPos, kUndoButtonPos + kUndoButtonSize};
+}
+
 void UndoButtonDrawable::Draw(sf::RenderWindow& win, float time, const ZState& state) {
   SetOutline(time);
   shape->setFillColor(sf::Color::Magenta);
   shape->setPosition(kUndoButtonPos);
   win.draw(*shape);
 }
+
+void BatchRenderer::Draw(sf::RenderWindow& win, const ZState& state) {
+  if (static_rings != state.board.Bits().rings) {
+    BuildStaticLayer(state);
+  }
+  BuildBallLayer(state);
+  win.draw(static_layer);
+  win.draw(ball_layer);
+}
+
+void BatchRenderer::BuildStaticLayer(const ZState& state) {
+  static const auto kHexVertices = MakeHexVertices(kCellSize);
+  static_layer.clear();
+  const auto& geometry = state.board.Geometry();
+  const auto& bits = state.board.Bits();
+  for (int cell : SetBits{bits.rings}) {
+    sf::Vector2f center = kBoardBase + CellCenterOffset(geometry, cell, kCellSize);
+    AppendPolygon(static_layer, center, kHexVertices, HexFillColor(geometry.CellQR(cell)));
+  }
+  sf::Vector2f pile_size(kBallRadius * 2.0f, kBallRadius * 2.0f);
+  for (auto pile_id : {PileId::kPlayer1, PileId::kPlayer2, PileId::kTable}) {
+    sf::Vector2f corner = PileCenter(pile_id) - sf::Vector2f(kBallRadius, kBallRadius);
+    AppendRect(static_layer, corner, pile_size, PileFillColor(pile_id));
+  }
+  AppendRect(static_layer, kUndoButtonPos, kUndoButtonSize, sf::Color::Magenta);
+  static_rings = bits.rings;
+}
+
+void BatchRenderer::BuildBallLayer(const ZState& state) {
+  static const auto kCircleVertices = MakeCircleVertices(kBallRadius, 24);
+  ball_layer.clear();
+  for (int idx = 0; idx < static_cast<int>(state.balls.size()); ++idx) {
+    AppendPolygon(ball_layer, BallCenter(state, idx), kCircleVertices,
+                  BallFillColor(state.balls[idx].color));
+  }
+}
+
+void HitTester::Build(const std::vector<Drawable::Ptr>& all_objects, const ZState& state) {
+  objects = &all_objects;
+  cell_objects.assign(state.board.Geometry().num_cells, -1);
+  ball_objects.assign(state.balls.size(), -1);
+  for (auto& bucket : buckets) {
+    bucket.clear();
+  }
+  const auto& geometry = state.board.Geometry();
+  for (int i = 0; i < static_cast<int>(all_objects.size()); ++i) {
+    auto index = all_objects[i]->GetIndex();
+    if (index.type == ObjType::kCell) {
+      cell_objects[geometry.IndexOf(*index.qr)] = i;
+      continue;
+    }
+    if (index.type == ObjType::kBall) {
+      ball_objects[*index.ball_id] = i;
+      continue;
+    }
+    // Static widgets go into every bucket their bounds overlap.
+    auto bounds = all_objects[i]->GetBounds();
+    int x0 = std::max(0, static_cast<int>(bounds.min.x / kBucketSize));
+    int y0 = std::max(0, static_cast<int>(bounds.min.y / kBucketSize));
+    int x1 = std::min(kBucketsX - 1, static_cast<int>(bounds.max.x / kBucketSize));
+    int y1 = std::min(kBucketsY - 1, static_cast<int>(bounds.max.y / kBucketSize));
+    for (int y = y0; y <= y1; ++y) {
+      for (int x = x0; x <= x1; ++x) {
+        buckets[y * kBucketsX + x].push_back(i);
+      }
+    }
+  }
+}
+
+std::optional<int> HitTester::Find(sf::Vector2f mouse, const ZState& state) const {
+  // Balls are on top of hexes and piles.
+  for (auto pile_id : {PileId::kPlayer1, PileId::kPlayer2, PileId::kTable}) {
+    if (std::abs(mouse.y - PileCenter(pile_id).y) >= kBallRadius) {
+      continue;
+    }
+    const auto& pile = state.GetPile(pile_id);
+    int slot = static_cast<int>(std::lround((mouse.x - kPilesBase.x) / (2.2f * kBallRadius))) - 1;
+    if (slot >= 0 && slot < pile.Size() &&
+        InCircle(mouse, BallCenter(state, pile.At(slot)), kBallRadius)) {
+      return ball_objects[pile.At(slot)];
+    }
+  }
+
+  const auto& geometry = state.board.Geometry();
+  int cell = geometry.IndexOf(OffsetToQR(mouse - kBoardBase, kCellSize));
+  if (cell != HexGeometry::kNoCell && state.board.Bits().HasRing(cell)) {
+    auto hex = state.board.Hex(geometry.CellQR(cell));
+    if (hex.ball_idx && InCircle(mouse, BallCenter(state, *hex.ball_idx), kBallRadius)) {
+      return ball_objects[*hex.ball_idx];
+    }
+    return cell_objects[cell];
+  }
+
+  if (mouse.x < 0.0f || mouse.y < 0.0f) {
+    return std::nullopt;
+  }
+  int x = static_cast<int>(mouse.x / kBucketSize);
+  int y = static_cast<int>(mouse.y / kBucketSize);
+  if (x >= kBucketsX || y >= kBucketsY) {
+    return std::nullopt;
+  }
+  for (int i : buckets[y * kBucketsX + x]) {
+    const auto& obj = (*objects)[i];
+    if (obj->IsVisible(state) && obj->IsHovered(mouse)) {
+      return i;
+    }
+  }
+  return std::nullopt;
+}
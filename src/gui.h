@@ -1,7 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <memory>
+#include <optional>
+#include <vector>
 
 #include <SFML/Graphics.hpp>
 
@@ -15,6 +19,13 @@ struct IOContext {
   bool right_btn_down = false;
   bool left_btn_up = false;
   bool right_btn_up = false;
+  // Space: the human has finished the turn, the engine is to move.
+  bool end_turn = false;
+};
+
+// Axis-aligned box of screen points.
+struct Bounds {
+  sf::Vector2f min, max;
 };
 
 struct Drawable {
@@ -24,6 +35,10 @@ struct Drawable {
     : shape(std::move(shape)), hit_radius(hit_radius) { }
   
   virtual bool IsHovered(const sf::Vector2f& mouse_ndc) const;
+  virtual Bounds GetBounds() const {
+    sf::Vector2f r(hit_radius, hit_radius);
+    return Bounds{center - r, center + r};
+  }
   void SetOutline(float time);
   
   virtual void Draw(sf::RenderWindow& win, float time, const ZState& state) = 0;
@@ -41,12 +56,12 @@ struct Drawable {
 struct HexDrawable : public Drawable {
   using Ptr = std::shared_ptr<HexDrawable>;
 
-  HexDrawable(QR pos);
+  HexDrawable(const HexGeometry& geometry, int cell);
 
   void Draw(sf::RenderWindow& win, float time, const ZState& state) override;
   
   bool IsVisible(const ZState& state) const override {
-    auto& cell = state.board.Hex(pos);
+    auto cell = state.board.Hex(pos);
     return cell.present;
   }
   
@@ -102,31 +117,72 @@ struct UndoButtonDrawable : public Drawable {
   void Draw(sf::RenderWindow& win, float time, const ZState& state) override;
   
   bool IsHovered(const sf::Vector2f& mouse_pos) const override;
+  Bounds GetBounds() const override;
 
   ObjIndex GetIndex() const override {
     return ObjIndex{.type = ObjType::kUndoButton};
   }
 };
 
+// Draws everything that is not highlighted in two batches: a cached layer of
+// rings, piles and buttons that is rebuilt only when the rings change, and
+// a layer of all balls.
+struct BatchRenderer {
+  void Draw(sf::RenderWindow& win, const ZState& state);
+
+ private:
+  void BuildStaticLayer(const ZState& state);
+  void BuildBallLayer(const ZState& state);
+
+  sf::VertexArray static_layer{sf::Triangles};
+  sf::VertexArray ball_layer{sf::Triangles};
+  // Rings the static layer was built for.
+  std::optional<Mask> static_rings;
+};
+
+// Finds the object under the mouse in constant time: hexes by inverting
+// the hex layout, balls from the hex or the pile slot under the mouse, and
+// the other widgets through a uniform grid of buckets.
+struct HitTester {
+  void Build(const std::vector<Drawable::Ptr>& objects, const ZState& state);
+
+  // Index of the visible object under the mouse.
+  std::optional<int> Find(sf::Vector2f mouse, const ZState& state) const;
+
+ private:
+  static constexpr float kBucketSize = 100.0f;
+  static constexpr int kBucketsX = 20;
+  static constexpr int kBucketsY = 15;
+
+  const std::vector<Drawable::Ptr>* objects = nullptr;
+  // Object indices of hexes by cell and of balls by ball id.
+  std::vector<int> cell_objects;
+  std::vector<int> ball_objects;
+  std::array<std::vector<int>, kBucketsX * kBucketsY> buckets;
+};
+
 struct ZGui {
   ZGui(std::shared_ptr<Zertz> zertz, std::shared_ptr<ZController> controller)
     : objects(InitObjects(zertz->Latest()))
-    , controller(controller) {}
+    , controller(controller) {
+    hit_tester.Build(objects, zertz->Latest());
+  }
 
   std::vector<std::shared_ptr<Drawable>> objects;
   std::shared_ptr<ZController> controller;
+  BatchRenderer renderer;
+  HitTester hit_tester;
+  std::optional<int> hovered_idx;
+  std::optional<int> selected_idx;
   
   std::vector<std::shared_ptr<Drawable>> InitObjects(const ZState& state) const {
     std::vector<std::shared_ptr<Drawable>> objects;
-    sf::Vector2f base(100.0f, 100.0f);
-    for (int h = 0; h < state.board.Height(); ++h) {
-      for (int w = 0; w < state.board.Width(); ++w) {
-        QR qr{h, w};
-        objects.push_back(std::make_shared<HexDrawable>(qr));
-      }
+    const auto& geometry = state.board.Geometry();
+    for (int cell = 0; cell < geometry.num_cells; ++cell) {
+      objects.push_back(std::make_shared<HexDrawable>(geometry, cell));
     }
     
-    for (const auto [pile_id, _] : state.piles) {
+    for (auto pile_id : {PileId::kPlayer1, PileId::kPlayer2, PileId::kTable}) {
       objects.push_back(std::make_shared<PileDrawable>(pile_id));
     }
 
@@ -140,54 +196,34 @@ struct ZGui {
   }
   
   void Draw(sf::RenderWindow& win, float time, const ZState& state, const IOContext& io) {
-    std::optional<int> hovered_idx;
-    for (int i = 0; i < objects.size(); ++i) {
-      auto& obj = objects[i];
-      obj->is_hovered = false;
-      if (obj->IsVisible(state) && obj->IsHovered(io.mouse_coords)) {
-        hovered_idx = i;
-      }
+    if (hovered_idx) {
+      objects[*hovered_idx]->is_hovered = false;
     }
+    hovered_idx = hit_tester.Find(io.mouse_coords, state);
 
+    // Only highlighted objects are drawn one by one, on top of the batches.
+    renderer.Draw(win, state);
     if (hovered_idx) {
       auto& obj = objects[*hovered_idx];
       obj->is_hovered = true;
-    }
-    
-    Drawable::Ptr hovered, selected;
-    for (auto& obj : objects) {
-      if (obj->is_hovered) {
-        hovered = obj;
-      } else if (obj->is_selected) {
-        selected = obj;
-      } else {
-        obj->Draw(win, time, state);
-      }
-    }
-    
-    if (hovered) {
-      hovered->Draw(win, time, state);
+      obj->Draw(win, time, state);
     }
 
-    if (selected) {
-      selected->Draw(win, time, state);
+    if (selected_idx && selected_idx != hovered_idx) {
+      objects[*selected_idx]->Draw(win, time, state);
     }
 
-    if (hovered_idx) {
-      auto& obj = objects[*hovered_idx];
-      obj->is_hovered = true;
-
-      if (io.left_btn_up) {
-        auto res = controller->OnClick(obj->GetIndex());
-        switch (res) {
-          case ActionResult::kSuccess:
-          case ActionResult::kFail:
-            ClearStates();
-            break;
-          case ActionResult::kSelected:
-            obj->is_selected = true;
-            break;
-        }
+    if (hovered_idx && io.left_btn_up) {
+      auto res = controller->OnClick(objects[*hovered_idx]->GetIndex());
+      switch (res) {
+        case ActionResult::kSuccess:
+        case ActionResult::kFail:
+          ClearStates();
+          break;
+        case ActionResult::kSelected:
+          objects[*hovered_idx]->is_selected = true;
+          selected_idx = hovered_idx;
+          break;
       }
     }
   }
@@ -197,5 +233,6 @@ struct ZGui {
       obj->is_hovered = false;
       obj->is_selected = false;
     }
+    selected_idx.reset();
   }
 };
\ No newline at end of file
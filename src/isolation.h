@@ -0,0 +1,67 @@
+#pragma once
+#include "bitboard.h"
+
+// Detection of isolated groups. A group of rings that is not connected to the
+// rest of the board and has no vacant rings is claimed by the player who
+// made it so. After a placement only two kinds of groups can become claimable:
+// the one holding the new ball and the ones split off by the removed ring.
+// So instead of labeling the whole board we flood fill from those few seeds,
+// and every fill stops as soon as it reaches a vacant ring.
+
+// Grows the group of rings around the seed. Returns the whole group if it
+// is fully occupied, or 0 once it reaches a vacant ring or a cell of `safe`
+// (already known to be connected to one). Cells visited by an unsuccessful
+// fill are added to `safe`.
+template <BoardVariant V>
+Mask FullyOccupiedGroup(const BitBoard& board, int seed, Mask& safe) {
+  const auto& neighbor_mask = HexTables<V>::kNeighborMask;
+  Mask stop = board.Vacant() | safe;
+  Mask group = Bit(seed);
+  Mask frontier = group;
+  while (frontier) {
+    if (group & stop) {
+      safe |= group;
+      return 0;
+    }
+    Mask next = 0;
+    for (int cell : SetBits{frontier}) {
+      next |= neighbor_mask[cell];
+    }
+    frontier = next & board.rings & ~group;
+    group |= frontier;
+  }
+  if (group & stop) {
+    safe |= group;
+    return 0;
+  }
+  return group;
+}
+
+// Rings of all groups that must be claimed after a ball was placed on
+// `placed` and `removed` was taken out of the board (kNoCell if
+// no ring was removed).
+template <BoardVariant V>
+Mask ClaimableGroups(const BitBoard& board, int placed, int removed) {
+  Mask safe = 0;
+  Mask claimed = 0;
+  auto Check = [&] (int seed) {
+    if (!board.HasRing(seed) || ((safe | claimed) & Bit(seed))) {
+      return;
+    }
+    claimed |= FullyOccupiedGroup<V>(board, seed, safe);
+  };
+
+  Check(placed);
+  if (removed != kNoCell) {
+    for (int cell : SetBits{HexTables<V>::kNeighborMask[removed] & board.rings}) {
+      Check(cell);
+    }
+  }
+  return claimed;
+}
+
+inline Mask ClaimableGroups(const BitBoard& board, int placed, int removed) {
+  return WithVariant(board.Variant(), [&] (auto tag) {
+    return ClaimableGroups<decltype(tag)::value>(board, placed, removed);
+  });
+}
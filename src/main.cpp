@@ -6,59 +6,132 @@
 #include <optional>
 #include <memory>
 #include <functional>
+#include <sstream>
+#include <thread>
 
 #include <SFML/Graphics.hpp>
 
 #include "zertz.h"
 #include "controller.h"
+#include "engine_worker.h"
+#include "evaluation.h"
 #include "gui.h"
+#include "render_scheduler.h"
 
-void UpdateLMB(IOContext& io) {
-  bool pressed = sf::Mouse::isButtonPressed(sf::Mouse::Left);
-  if (io.left_btn_down && !pressed) {
-    io.left_btn_down = false;
-    io.left_btn_up = true;
-    return;
-  } 
-  
-  if (io.left_btn_up) {
-    io.left_btn_up = false;
-    return;
-  }
-  
-  if (pressed) {
-    io.left_btn_down = true;
-    io.left_btn_up = false;
+void HandleEvent(sf::RenderWindow& win, const sf::Event& event, IOContext& io) {
+  switch (event.type) {
+    case sf::Event::Closed:
+      win.close();
+      break;
+    case sf::Event::MouseMoved:
+      io.mouse_coords = sf::Vector2f(event.mouseMove.x, event.mouseMove.y);
+      break;
+    case sf::Event::MouseButtonPressed:
+      io.mouse_coords = sf::Vector2f(event.mouseButton.x, event.mouseButton.y);
+      if (event.mouseButton.button == sf::Mouse::Left) {
+        io.left_btn_down = true;
+      } else if (event.mouseButton.button == sf::Mouse::Right) {
+        io.right_btn_down = true;
+      }
+      break;
+    case sf::Event::MouseButtonReleased:
+      io.mouse_coords = sf::Vector2f(event.mouseButton.x, event.mouseButton.y);
+      if (event.mouseButton.button == sf::Mouse::Left) {
+        io.left_btn_down = false;
+        io.left_btn_up = true;
+      } else if (event.mouseButton.button == sf::Mouse::Right) {
+        io.right_btn_down = false;
+        io.right_btn_up = true;
+      }
+      break;
+    case sf::Event::KeyPressed:
+      if (event.key.code == sf::Keyboard::Space) {
+        io.end_turn = true;
+      }
+      break;
+    default:
+      break;
   }
 }
 
-void UpdateIO(sf::RenderWindow& win, IOContext& io) {
-  auto pos = sf::Mouse::getPosition(win);
-  io.mouse_coords = sf::Vector2f(pos.x, pos.y);
-  UpdateLMB(io);
+std::string EngineTitle(const EngineProgress& progress) {
+  std::ostringstream title;
+  title << "The Game - " << (progress.pondering ? "pondering" : "engine")
+        << " depth " << progress.depth << ", score " << progress.score
+        << ", " << progress.nodes << " nodes";
+  return title.str();
 }
 
 int main() {
+    // Outlives the engine, whose threads request redraws.
+    RenderScheduler scheduler;
     sf::RenderWindow window(sf::VideoMode(1920, 1440), "The Game");
+    window.setFramerateLimit(1000 / RenderScheduler::kFrameMs);
 
     // Model, view, controller
     auto zertz = std::make_shared<Zertz>();
     auto controller = std::make_shared<ZController>(zertz);
     auto gui = std::make_shared<ZGui>(zertz, controller);
 
+    // The engine plays the second player and thinks in the background.
+    int threads = std::max(1u, std::thread::hardware_concurrency() / 2);
+    auto engine =
+        std::make_shared<EngineWorker>(std::make_shared<HeuristicEvaluator>(), 64, threads);
+    engine->SetListener([&scheduler] { scheduler.RequestRedraw(); });
+    // Only a running search or ponder keeps the loop from blocking in waitEvent.
+    engine->SetActivityListener([&scheduler] (bool searching) {
+      if (searching) {
+        scheduler.AddRedrawSource();
+      } else {
+        scheduler.RemoveRedrawSource();
+      }
+    });
+    controller->AttachEngine(engine, PlayerId::kPlayer2, SearchLimits{.time_ms = 3000});
+    uint32_t shown_progress = 0;
+
     IOContext io;
     sf::Clock clock;
+    // Stays valid for the whole game, frames are drawn from it in place.
+    const auto& state = zertz->Latest();
     while (window.isOpen()) {
       sf::Event event;
-      while (window.pollEvent(event)) {
-        if (event.type == sf::Event::Closed)
-            window.close();
+      bool had_input = false;
+      if (scheduler.Wait(window, event, zertz->Version())) {
+        do {
+          HandleEvent(window, event, io);
+          had_input = true;
+        } while (window.pollEvent(event));
+      }
+
+      if (io.end_turn) {
+        io.end_turn = false;
+        controller->EndTurn();
+      }
+      if (controller->Update()) {
+        gui->ClearStates();
+      }
+      auto progress = engine->Progress();
+      if (progress.version != shown_progress) {
+        shown_progress = progress.version;
+        window.setTitle(EngineTitle(progress));
+      }
+
+      uint64_t version = zertz->Version();
+      if (!window.isOpen() || !scheduler.NeedsRedraw(version, had_input)) {
+        continue;
       }
       window.clear();
-      UpdateIO(window, io);
       auto time = clock.getElapsedTime();
-      gui->Draw(window, time.asSeconds(), zertz->Latest(), io);
+      gui->Draw(window, time.asSeconds(), state, io);
       window.display();
+      scheduler.OnDrawn(version);
+
+      // Clicks change selection and highlights, which show up in the next frame.
+      if (io.left_btn_up || io.right_btn_up) {
+        io.left_btn_up = false;
+        io.right_btn_up = false;
+        scheduler.RequestRedraw();
+      }
     }
 
     return 0;
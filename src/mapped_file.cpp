@@ -0,0 +1,41 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error("Cannot open " + path);
+  }
+  size_ = st.st_size;
+  if (size_ == 0) {
+    close(fd);
+    return;
+  }
+  data_ = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping keeps the file open.
+  close(fd);
+  if (data_ == MAP_FAILED) {
+    data_ = nullptr;
+    throw std::runtime_error("Cannot map " + path);
+  }
+  // The tables and books mapped are probed at scattered offsets, so
+  // read-ahead would only waste memory.
+  madvise(data_, size_, MADV_RANDOM);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) {
+    munmap(data_, size_);
+  }
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A whole file mapped read-only into memory. Pages are read on demand and
+// shared through the page cache by every process that maps the file.
+class MappedFile {
+ public:
+  // Throws std::runtime_error if the file cannot be opened or mapped. An
+  // empty file has no data.
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const uint8_t* Data() const { return static_cast<const uint8_t*>(data_); }
+  size_t Size() const { return size_; }
+
+ private:
+  void* data_ = nullptr;
+  size_t size_ = 0;
+};
@@ -0,0 +1,218 @@
+#include "mcts.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const uint32_t kNoNode = ~uint32_t{0};
+const uint32_t kVirtualLoss = 3;
+const double kExploration = 1.4;
+const int kMaxDepth = 256;
+
+int NthBit(Mask mask, int n) {
+  for (int i = 0; i < n; ++i) {
+    mask &= mask - 1;
+  }
+  return LowestBit(mask);
+}
+
+// Captures are drawn from the generated list. Placements are drawn as
+// independent color, cell and ring choices without building the whole
+// list, which is what makes playouts cheap.
+template <typename Rng>
+std::optional<Move> RandomMove(const Position& pos, Rng& rng, MoveList& moves) {
+  moves.Clear();
+  GenerateCaptures(pos, moves);
+  if (!moves.Empty()) {
+    return moves[rng() % moves.Size()];
+  }
+
+  const auto& reserve = pos.Reserve(pos.to_move);
+  int colors[kNumColors];
+  int num_colors = 0;
+  for (int c = 0; c < kNumColors; ++c) {
+    if (reserve[c] > 0) {
+      colors[num_colors++] = c;
+    }
+  }
+  Mask vacant = pos.board.Vacant();
+  if (num_colors == 0 || !vacant) {
+    return std::nullopt;
+  }
+
+  auto color = static_cast<BallColor>(colors[rng() % num_colors]);
+  int cell = NthBit(vacant, rng() % PopCount(vacant));
+  Mask free = FreeRings(pos.board) & ~Bit(cell);
+  int ring = free ? NthBit(free, rng() % PopCount(free)) : Move::kNoRing;
+  return Move::Placement(color, cell, ring);
+}
+
+}
+
+Mcts::Mcts(size_t memory_megabytes, int threads)
+  : threads_(std::max(threads, 1))
+  , capacity_(std::max<size_t>(memory_megabytes * 1024 * 1024 / sizeof(Node), 1))
+  , nodes_(std::make_unique<Node[]>(capacity_)) {}
+
+uint32_t Mcts::Allocate(uint32_t count) {
+  if (next_.load(std::memory_order_relaxed) + count > capacity_) {
+    return kNoNode;
+  }
+  uint32_t start = next_.fetch_add(count, std::memory_order_relaxed);
+  if (start + count > capacity_) {
+    return kNoNode;
+  }
+  return start;
+}
+
+MctsInfo Mcts::Search(const Position& root, const MctsLimits& limits) {
+  auto start = std::chrono::steady_clock::now();
+  // Dropping the previous tree.
+  next_ = 0;
+  uint32_t root_idx = Allocate(1);
+  nodes_[root_idx].Init(Move::None(), Opponent(root.to_move));
+
+  stop_ = false;
+  playouts_ = 0;
+  max_playouts_ = limits.playouts;
+  deadline_.reset();
+  if (limits.time_ms > 0) {
+    deadline_ = start + std::chrono::milliseconds(limits.time_ms);
+  }
+
+  std::vector<std::thread> helpers;
+  for (int i = 1; i < threads_; ++i) {
+    helpers.emplace_back([this, &root, i] { Worker(root, i); });
+  }
+  Worker(root, 0);
+  for (auto& helper : helpers) {
+    helper.join();
+  }
+
+  MctsInfo info;
+  info.playouts = playouts_;
+  info.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  info.nodes = std::min<size_t>(next_, capacity_);
+
+  const Node& node = nodes_[root_idx];
+  if (node.state == Node::kExpanded) {
+    uint32_t first = node.first_child;
+    uint32_t best_visits = 0;
+    for (uint32_t i = first; i < first + node.num_children; ++i) {
+      uint32_t visits = nodes_[i].visits;
+      if (visits > best_visits || info.best_move == Move::None()) {
+        best_visits = visits;
+        info.best_move = nodes_[i].move;
+        info.win_rate = visits ? nodes_[i].score / (2.0 * visits) : 0.0;
+      }
+    }
+  }
+  return info;
+}
+
+void Mcts::Worker(const Position& root, int thread_idx) {
+  Rng rng(0x9E3779B97F4A7C15 * (thread_idx + 1));
+  MoveList moves;
+  for (uint64_t i = 0; !stop_.load(std::memory_order_relaxed); ++i) {
+    Iterate(root, rng, moves);
+    uint64_t playouts = playouts_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if ((max_playouts_ && playouts >= max_playouts_) ||
+        (deadline_ && (i & 63) == 0 && std::chrono::steady_clock::now() >= *deadline_)) {
+      stop_ = true;
+    }
+  }
+}
+
+void Mcts::Iterate(Position pos, Rng& rng, MoveList& moves) {
+  std::array<uint32_t, kMaxDepth> path;
+  int length = 0;
+  uint32_t node = 0;
+  path[length++] = node;
+  nodes_[node].visits.fetch_add(kVirtualLoss, std::memory_order_relaxed);
+  while (length < kMaxDepth &&
+         nodes_[node].state.load(std::memory_order_acquire) == Node::kExpanded &&
+         nodes_[node].num_children.load(std::memory_order_relaxed) > 0) {
+    node = Select(node);
+    nodes_[node].visits.fetch_add(kVirtualLoss, std::memory_order_relaxed);
+    pos.MakeMove(nodes_[node].move);
+    path[length++] = node;
+  }
+
+  // Leaves are expanded on their second visit, so that single playouts
+  // through wide nodes do not use up the arena.
+  Node& leaf = nodes_[node];
+  uint8_t expected = Node::kLeaf;
+  if (!pos.Winner() && next_.load(std::memory_order_relaxed) < capacity_ &&
+      (node == 0 || leaf.visits.load(std::memory_order_relaxed) > kVirtualLoss) &&
+      leaf.state.compare_exchange_strong(expected, Node::kExpanding)) {
+    Expand(node, pos, rng, moves);
+  }
+
+  auto winner = Playout(pos, rng, moves);
+  for (int i = 0; i < length; ++i) {
+    Node& n = nodes_[path[i]];
+    uint32_t points = !winner ? 1 : *winner == n.mover ? 2 : 0;
+    n.score.fetch_add(points, std::memory_order_relaxed);
+    n.visits.fetch_sub(kVirtualLoss - 1, std::memory_order_relaxed);
+  }
+}
+
+uint32_t Mcts::Select(uint32_t parent) const {
+  const Node& node = nodes_[parent];
+  uint32_t first = node.first_child.load(std::memory_order_relaxed);
+  uint32_t count = node.num_children.load(std::memory_order_relaxed);
+  double log_visits = std::log(std::max<uint32_t>(node.visits.load(std::memory_order_relaxed), 1));
+
+  uint32_t best = first;
+  double best_value = -1.0;
+  for (uint32_t i = first; i < first + count; ++i) {
+    uint32_t visits = nodes_[i].visits.load(std::memory_order_relaxed);
+    if (visits == 0) {
+      // Children are shuffled on expansion, so the first unvisited is random.
+      return i;
+    }
+    double q = nodes_[i].score.load(std::memory_order_relaxed) / (2.0 * visits);
+    double value = q + kExploration * std::sqrt(log_visits / visits);
+    if (value > best_value) {
+      best_value = value;
+      best = i;
+    }
+  }
+  return best;
+}
+
+void Mcts::Expand(uint32_t node, const Position& pos, Rng& rng, MoveList& moves) {
+  Node& n = nodes_[node];
+  GenerateMoves(pos, moves);
+  uint32_t first = moves.Empty() ? 0 : Allocate(moves.Size());
+  if (first == kNoNode) {
+    // The arena is full: the node stays a leaf for the rest of the search.
+    n.state.store(Node::kLeaf, std::memory_order_release);
+    return;
+  }
+  std::shuffle(moves.begin(), moves.end(), rng);
+  for (int i = 0; i < moves.Size(); ++i) {
+    nodes_[first + i].Init(moves[i], pos.to_move);
+  }
+  n.first_child.store(first, std::memory_order_relaxed);
+  n.num_children.store(moves.Size(), std::memory_order_relaxed);
+  n.state.store(Node::kExpanded, std::memory_order_release);
+}
+
+std::optional<PlayerId> Mcts::Playout(Position pos, Rng& rng, MoveList& moves) const {
+  for (int ply = 0; ply < kMaxDepth; ++ply) {
+    if (auto winner = pos.Winner()) {
+      return winner;
+    }
+    auto move = RandomMove(pos, rng, moves);
+    if (!move) {
+      // No legal moves: the side to move loses.
+      return Opponent(pos.to_move);
+    }
+    pos.MakeMove(*move);
+  }
+  return std::nullopt;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+
+#include "movegen.h"
+#include "position.h"
+
+// Monte Carlo tree search with UCT selection and random playouts. Several
+// threads walk one shared tree; virtual loss keeps them from all following
+// the same path. Nodes live in a fixed arena, children of a node are one
+// contiguous block, so memory is capped up front and the tree is freed in
+// O(1) by resetting the arena.
+
+struct MctsLimits {
+  // Zero means no limit.
+  int64_t time_ms = 0;
+  uint64_t playouts = 0;
+};
+
+struct MctsInfo {
+  uint64_t playouts = 0;
+  double seconds = 0.0;
+  size_t nodes = 0;
+  Move best_move = Move::None();
+  // Share of the playouts through the best move won by the side to move.
+  double win_rate = 0.0;
+
+  uint64_t PlayoutsPerSecond() const {
+    return seconds > 0.0 ? static_cast<uint64_t>(playouts / seconds) : 0;
+  }
+};
+
+class Mcts {
+ public:
+  Mcts(size_t memory_megabytes = 256, int threads = 1);
+
+  MctsInfo Search(const Position& root, const MctsLimits& limits);
+
+  // Can be called from any thread.
+  void Stop() { stop_ = true; }
+
+  size_t Capacity() const { return capacity_; }
+
+ private:
+  struct Node {
+    enum State : uint8_t { kLeaf, kExpanding, kExpanded };
+
+    // Visits include virtual losses of threads currently below the node.
+    std::atomic<uint32_t> visits;
+    // In half points for the player who made `move`: win 2, draw 1.
+    std::atomic<uint32_t> score;
+    std::atomic<uint32_t> first_child;
+    std::atomic<uint16_t> num_children;
+    std::atomic<uint8_t> state;
+    Move move;
+    PlayerId mover;
+
+    void Init(Move m, PlayerId by) {
+      visits.store(0, std::memory_order_relaxed);
+      score.store(0, std::memory_order_relaxed);
+      first_child.store(0, std::memory_order_relaxed);
+      num_children.store(0, std::memory_order_relaxed);
+      state.store(kLeaf, std::memory_order_relaxed);
+      move = m;
+      mover = by;
+    }
+  };
+
+  using Rng = std::mt19937_64;
+
+  void Worker(const Position& root, int thread_idx);
+  // Selects a leaf, expands it, plays out and backs up the result.
+  void Iterate(Position pos, Rng& rng, MoveList& moves);
+  uint32_t Select(uint32_t parent) const;
+  void Expand(uint32_t node, const Position& pos, Rng& rng, MoveList& moves);
+  // Winner of a random game from the position, nullopt for a draw.
+  std::optional<PlayerId> Playout(Position pos, Rng& rng, MoveList& moves) const;
+
+  // First node of a block of `count` nodes, or kNoNode if the arena is full.
+  uint32_t Allocate(uint32_t count);
+
+  const int threads_;
+  size_t capacity_;
+  std::unique_ptr<Node[]> nodes_;
+  std::atomic<uint32_t> next_{0};
+
+  std::atomic<bool> stop_{false};
+  std::atomic<uint64_t> playouts_{0};
+  uint64_t max_playouts_ = 0;
+  std::optional<std::chrono::steady_clock::time_point> deadline_;
+};
@@ -0,0 +1,168 @@
+#pragma once
+#include <array>
+#include <cassert>
+
+#include "position.h"
+
+// Legal move generation. Nothing here allocates: moves are written into a
+// MoveList that lives on the caller's stack.
+
+class MoveList {
+ public:
+  // Colors x placement cells x removed rings bounds every position.
+  static constexpr int kCapacity = kNumColors * HexGeometry::kMaxCells * HexGeometry::kMaxCells;
+
+  void Add(Move move) {
+    assert(size_ < kCapacity);
+    moves_[size_++] = move;
+  }
+
+  void Clear() { size_ = 0; }
+  int Size() const { return size_; }
+  bool Empty() const { return size_ == 0; }
+
+  Move& operator[](int i) { return moves_[i]; }
+  Move operator[](int i) const { return moves_[i]; }
+
+  Move* begin() { return moves_.data(); }
+  Move* end() { return moves_.data() + size_; }
+  const Move* begin() const { return moves_.data(); }
+  const Move* end() const { return moves_.data() + size_; }
+
+ private:
+  std::array<Move, kCapacity> moves_;
+  int size_ = 0;
+};
+
+// The rule functions below are instantiated for every board variant, so
+// that geometry lookups index the compile-time HexTables<V> and loops over
+// the cells have constant bounds. The plain overloads dispatch on the
+// variant of the position once per call.
+
+// A ring is free if it is vacant and two adjacent edges of it are not
+// touching other rings, i.e. it can be slid out of the board.
+template <BoardVariant V>
+bool IsFreeRing(const BitBoard& board, int cell) {
+  const auto& edges = HexTables<V>::kFreeEdges[cell];
+  for (int d = 0; d < kNumDirections; ++d) {
+    if (!(edges[d] & board.rings)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <BoardVariant V>
+Mask FreeRings(const BitBoard& board) {
+  Mask free = 0;
+  for (int cell : SetBits{board.Vacant()}) {
+    if (IsFreeRing<V>(board, cell)) {
+      free |= Bit(cell);
+    }
+  }
+  return free;
+}
+
+// Single jumps of the ball on the cell.
+template <BoardVariant V>
+void GenerateCapturesFrom(const Position& pos, int cell, MoveList& moves) {
+  using Tables = HexTables<V>;
+  Mask occupied = pos.board.Occupied();
+  Mask vacant = pos.board.Vacant();
+  for (int d = 0; d < kNumDirections; ++d) {
+    int over = Tables::kNeighbors[cell][d];
+    if (over == kNoCell || !(occupied & Bit(over))) {
+      continue;
+    }
+    int land = Tables::kJumps[cell][d];
+    if (land != kNoCell && (vacant & Bit(land))) {
+      moves.Add(Move::Capture(cell, d));
+    }
+  }
+}
+
+template <BoardVariant V>
+void GenerateCaptures(const Position& pos, MoveList& moves) {
+  if (pos.chain_cell != kNoCell) {
+    GenerateCapturesFrom<V>(pos, pos.chain_cell, moves);
+    return;
+  }
+  for (int cell : SetBits{pos.board.Occupied()}) {
+    GenerateCapturesFrom<V>(pos, cell, moves);
+  }
+}
+
+// Every ball available to the player on every vacant ring, followed by the
+// removal of a free ring (if there is one left after the placement).
+template <BoardVariant V>
+void GeneratePlacements(const Position& pos, MoveList& moves) {
+  const auto& reserve = pos.Reserve(pos.to_move);
+  Mask vacant = pos.board.Vacant();
+  Mask free = FreeRings<V>(pos.board);
+  for (int c = 0; c < kNumColors; ++c) {
+    if (reserve[c] == 0) {
+      continue;
+    }
+    auto color = static_cast<BallColor>(c);
+    for (int cell : SetBits{vacant}) {
+      Mask removable = free & ~Bit(cell);
+      if (!removable) {
+        moves.Add(Move::Placement(color, cell, Move::kNoRing));
+        continue;
+      }
+      for (int ring : SetBits{removable}) {
+        moves.Add(Move::Placement(color, cell, ring));
+      }
+    }
+  }
+}
+
+// Captures are mandatory, so placements are only generated when there is
+// nothing to jump. A finished game has no legal moves.
+template <BoardVariant V>
+void GenerateMoves(const Position& pos, MoveList& moves) {
+  moves.Clear();
+  if (pos.Winner()) {
+    return;
+  }
+  GenerateCaptures<V>(pos, moves);
+  if (moves.Empty()) {
+    GeneratePlacements<V>(pos, moves);
+  }
+}
+
+inline bool IsFreeRing(const BitBoard& board, int cell) {
+  return WithVariant(board.Variant(), [&] (auto tag) {
+    return IsFreeRing<decltype(tag)::value>(board, cell);
+  });
+}
+
+inline Mask FreeRings(const BitBoard& board) {
+  return WithVariant(board.Variant(), [&] (auto tag) {
+    return FreeRings<decltype(tag)::value>(board);
+  });
+}
+
+inline void GenerateCapturesFrom(const Position& pos, int cell, MoveList& moves) {
+  WithVariant(pos.board.Variant(), [&] (auto tag) {
+    GenerateCapturesFrom<decltype(tag)::value>(pos, cell, moves);
+  });
+}
+
+inline void GenerateCaptures(const Position& pos, MoveList& moves) {
+  WithVariant(pos.board.Variant(), [&] (auto tag) {
+    GenerateCaptures<decltype(tag)::value>(pos, moves);
+  });
+}
+
+inline void GeneratePlacements(const Position& pos, MoveList& moves) {
+  WithVariant(pos.board.Variant(), [&] (auto tag) {
+    GeneratePlacements<decltype(tag)::value>(pos, moves);
+  });
+}
+
+inline void GenerateMoves(const Position& pos, MoveList& moves) {
+  WithVariant(pos.board.Variant(), [&] (auto tag) {
+    GenerateMoves<decltype(tag)::value>(pos, moves);
+  });
+}
@@ -0,0 +1,359 @@
+#include "nnue.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using Weights = NnueWeights;
+
+constexpr char kMagic[4] = {'Z', 'N', 'N', '1'};
+
+using Column = std::array<int16_t, Weights::kHidden>;
+
+// Occupancy of every cell state, in BoardFeature order.
+std::array<Mask, Weights::kCellStates> Planes(const BitBoard& board) {
+  return {board.Vacant(), board.balls[0], board.balls[1], board.balls[2]};
+}
+
+void AddColumn(NnueAccumulator& acc, const Column& column) {
+#ifdef __AVX2__
+  for (int i = 0; i < Weights::kHidden; i += 16) {
+    auto* out = reinterpret_cast<__m256i*>(&acc.values[i]);
+    auto in = _mm256_load_si256(reinterpret_cast<const __m256i*>(&column[i]));
+    _mm256_store_si256(out, _mm256_add_epi16(_mm256_load_si256(out), in));
+  }
+#else
+  for (int i = 0; i < Weights::kHidden; ++i) {
+    acc.values[i] += column[i];
+  }
+#endif
+}
+
+void SubColumn(NnueAccumulator& acc, const Column& column) {
+#ifdef __AVX2__
+  for (int i = 0; i < Weights::kHidden; i += 16) {
+    auto* out = reinterpret_cast<__m256i*>(&acc.values[i]);
+    auto in = _mm256_load_si256(reinterpret_cast<const __m256i*>(&column[i]));
+    _mm256_store_si256(out, _mm256_sub_epi16(_mm256_load_si256(out), in));
+  }
+#else
+  for (int i = 0; i < Weights::kHidden; ++i) {
+    acc.values[i] -= column[i];
+  }
+#endif
+}
+
+// Number of count features, all active at once.
+constexpr int kCountColumns = Weights::kCountPiles * kNumColors;
+
+// The accumulator plus the count columns, clamped to [0, 127] as bytes.
+void Hidden(const NnueAccumulator& acc, const Column* const* counts, uint8_t* out) {
+#ifdef __AVX2__
+  const auto max = _mm256_set1_epi16(127);
+  for (int i = 0; i < Weights::kHidden; i += 32) {
+    auto a = _mm256_load_si256(reinterpret_cast<const __m256i*>(&acc.values[i]));
+    auto b = _mm256_load_si256(reinterpret_cast<const __m256i*>(&acc.values[i + 16]));
+    for (int k = 0; k < kCountColumns; ++k) {
+      const auto* column = reinterpret_cast<const __m256i*>(&(*counts[k])[i]);
+      a = _mm256_add_epi16(a, _mm256_load_si256(column));
+      b = _mm256_add_epi16(b, _mm256_load_si256(column + 1));
+    }
+    // packus saturates negatives to 0 and interleaves the 128-bit lanes.
+    auto packed = _mm256_packus_epi16(_mm256_min_epi16(a, max), _mm256_min_epi16(b, max));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(out + i),
+                       _mm256_permute4x64_epi64(packed, 0xD8));
+  }
+#else
+  for (int i = 0; i < Weights::kHidden; ++i) {
+    int16_t value = acc.values[i];
+    for (int k = 0; k < kCountColumns; ++k) {
+      value += (*counts[k])[i];
+    }
+    out[i] = static_cast<uint8_t>(std::clamp<int>(value, 0, 127));
+  }
+#endif
+}
+
+#ifdef __AVX2__
+// sum + the products of bytes and int8 weights, summed in groups of four.
+inline __m256i DotAccumulate(__m256i sum, __m256i in, __m256i weights) {
+#ifdef __AVXVNNI__
+  return _mm256_dpbusd_avx_epi32(sum, in, weights);
+#else
+  auto products = _mm256_maddubs_epi16(in, weights);
+  return _mm256_add_epi32(sum, _mm256_madd_epi16(products, _mm256_set1_epi16(1)));
+#endif
+}
+#endif
+
+// Dot product of bytes in [0, 127] with int8 weights; n is a multiple of
+// 32. Pairs of products stay below the int16 saturation of maddubs.
+int32_t Dot(const uint8_t* in, const int8_t* weights, int n) {
+#ifdef __AVX2__
+  auto sum = _mm256_setzero_si256();
+  for (int i = 0; i < n; i += 32) {
+    sum = DotAccumulate(sum, _mm256_load_si256(reinterpret_cast<const __m256i*>(in + i)),
+                        _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + i)));
+  }
+  auto half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+  return _mm_cvtsi128_si32(half);
+#else
+  int32_t sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += in[i] * weights[i];
+  }
+  return sum;
+#endif
+}
+
+// out[i] = in . layer1[i] + layer1_bias[i] for all rows. With AVX2 four
+// rows are reduced together, so there is one horizontal sum per four rows.
+void Layer1(const uint8_t* in, const Weights& w, int32_t* out) {
+#ifdef __AVX2__
+  constexpr int kChunks = Weights::kHidden / 32;
+  __m256i input[kChunks];
+  for (int i = 0; i < kChunks; ++i) {
+    input[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(in + 32 * i));
+  }
+  for (int row = 0; row < Weights::kLayer1; row += 4) {
+    __m256i sums[4];
+    for (int k = 0; k < 4; ++k) {
+      const auto* weights = reinterpret_cast<const __m256i*>(w.layer1[row + k].data());
+      sums[k] = _mm256_setzero_si256();
+      for (int i = 0; i < kChunks; ++i) {
+        sums[k] = DotAccumulate(sums[k], input[i], _mm256_load_si256(weights + i));
+      }
+    }
+    auto sum = _mm256_hadd_epi32(_mm256_hadd_epi32(sums[0], sums[1]),
+                                 _mm256_hadd_epi32(sums[2], sums[3]));
+    auto total = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    total = _mm_add_epi32(total, _mm_load_si128(
+        reinterpret_cast<const __m128i*>(&w.layer1_bias[row])));
+    _mm_store_si128(reinterpret_cast<__m128i*>(out + row), total);
+  }
+#else
+  for (int row = 0; row < Weights::kLayer1; ++row) {
+    out[row] = Dot(in, w.layer1[row].data(), Weights::kHidden) + w.layer1_bias[row];
+  }
+#endif
+}
+
+// Accumulator of the board features given as cell masks.
+void RefreshPlanes(const Weights& w, const std::array<Mask, Weights::kCellStates>& planes,
+                   NnueAccumulator& acc) {
+  acc.values = w.feature_bias;
+  for (int state = 0; state < Weights::kCellStates; ++state) {
+    for (int cell : SetBits{planes[state]}) {
+      AddColumn(acc, w.feature[Weights::BoardFeature(state, cell)]);
+    }
+  }
+}
+
+// The layers after the accumulator, given the columns of the count features.
+int Layers(const Weights& w, const NnueAccumulator& acc, const Column* const* counts) {
+  alignas(32) std::array<uint8_t, Weights::kHidden> hidden;
+  Hidden(acc, counts, hidden.data());
+  alignas(32) std::array<int32_t, Weights::kLayer1> sums;
+  Layer1(hidden.data(), w, sums.data());
+  alignas(32) std::array<uint8_t, Weights::kLayer1> layer1_bytes;
+  for (int i = 0; i < Weights::kLayer1; ++i) {
+    layer1_bytes[i] = static_cast<uint8_t>(std::clamp(sums[i] >> Weights::kLayer1Shift, 0, 127));
+  }
+  int32_t out = Dot(layer1_bytes.data(), w.output.data(), Weights::kLayer1) + w.output_bias;
+  return std::clamp(out >> Weights::kOutputShift, -kMaxEval, kMaxEval);
+}
+
+// Accumulators along the search path. Push only records the board; the
+// accumulator of a ply is computed when it is evaluated, from the closest
+// computed ply below it, so nodes that are cut off before their
+// evaluation cost nothing.
+class NnueStack : public EvalStack {
+ public:
+  explicit NnueStack(const NnueEvaluator& evaluator, const Weights& weights)
+    : evaluator_(evaluator), weights_(weights) {}
+
+  void Reset(const Position& pos) override {
+    top_ = 0;
+    entries_[0].planes = Planes(pos.board);
+    evaluator_.Refresh(pos.board, entries_[0].acc);
+    entries_[0].computed = true;
+  }
+
+  void Push(const Position& pos) override {
+    assert(top_ + 1 < static_cast<int>(entries_.size()));
+    Entry& entry = entries_[++top_];
+    entry.planes = Planes(pos.board);
+    entry.computed = false;
+  }
+
+  void Pop() override { --top_; }
+
+  int Evaluate(const Position& pos) override {
+    int base = top_;
+    while (!entries_[base].computed) {
+      --base;
+    }
+    for (int ply = base + 1; ply <= top_; ++ply) {
+      const Entry& parent = entries_[ply - 1];
+      Entry& entry = entries_[ply];
+      entry.acc = parent.acc;
+      for (int state = 0; state < Weights::kCellStates; ++state) {
+        for (int cell : SetBits{parent.planes[state] & ~entry.planes[state]}) {
+          SubColumn(entry.acc, weights_.feature[Weights::BoardFeature(state, cell)]);
+        }
+        for (int cell : SetBits{entry.planes[state] & ~parent.planes[state]}) {
+          AddColumn(entry.acc, weights_.feature[Weights::BoardFeature(state, cell)]);
+        }
+      }
+      entry.computed = true;
+    }
+    return evaluator_.Forward(entries_[top_].acc, pos);
+  }
+
+ private:
+  struct Entry {
+    NnueAccumulator acc;
+    std::array<Mask, Weights::kCellStates> planes;
+    bool computed = false;
+  };
+
+  const NnueEvaluator& evaluator_;
+  const Weights& weights_;
+  std::array<Entry, kMaxPly + 1> entries_;
+  int top_ = 0;
+};
+
+}
+
+void NnueBatchInputs::Compute(const PositionBatch& batch) {
+  size_t n = batch.Size();
+  for (auto& plane : planes) {
+    plane.resize(n);
+  }
+  const Mask* rings = batch.rings.data();
+  const Mask* white = batch.balls[0].data();
+  const Mask* grey = batch.balls[1].data();
+  const Mask* black = batch.balls[2].data();
+  Mask* vacant = planes[0].data();
+  for (size_t i = 0; i < n; ++i) {
+    vacant[i] = rings[i] & ~(white[i] | grey[i] | black[i]);
+  }
+  for (int c = 0; c < kNumColors; ++c) {
+    std::copy(batch.balls[c].begin(), batch.balls[c].end(), planes[1 + c].begin());
+  }
+  // Count piles are in the same order in the batch and in the features.
+  static_assert(PositionBatch::kPiles == Weights::kCountPiles);
+  for (int pile = 0; pile < Weights::kCountPiles; ++pile) {
+    for (int c = 0; c < kNumColors; ++c) {
+      auto& features = counts[pile * kNumColors + c];
+      features.resize(n);
+      const uint8_t* in = batch.counts[pile][c].data();
+      uint16_t* out = features.data();
+      const int base = Weights::CountFeature(pile, c, 0);
+      for (size_t i = 0; i < n; ++i) {
+        out[i] = static_cast<uint16_t>(base + std::min<int>(in[i], Weights::kMaxCount));
+      }
+    }
+  }
+}
+
+std::shared_ptr<NnueWeights> NnueWeights::Load(const std::string& path) {
+  FILE* file = std::fopen(path.c_str(), "rb");
+  if (!file) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  char magic[4];
+  uint32_t shape[3];
+  auto weights = std::make_shared<NnueWeights>();
+  bool ok = std::fread(magic, sizeof(magic), 1, file) == 1 &&
+      std::memcmp(magic, kMagic, sizeof(kMagic)) == 0 &&
+      std::fread(shape, sizeof(shape), 1, file) == 1 &&
+      shape[0] == kInputs && shape[1] == kHidden && shape[2] == kLayer1 &&
+      std::fread(&weights->feature, sizeof(weights->feature), 1, file) == 1 &&
+      std::fread(&weights->feature_bias, sizeof(weights->feature_bias), 1, file) == 1 &&
+      std::fread(&weights->layer1, sizeof(weights->layer1), 1, file) == 1 &&
+      std::fread(&weights->layer1_bias, sizeof(weights->layer1_bias), 1, file) == 1 &&
+      std::fread(&weights->output, sizeof(weights->output), 1, file) == 1 &&
+      std::fread(&weights->output_bias, sizeof(weights->output_bias), 1, file) == 1 &&
+      std::fgetc(file) == EOF;
+  std::fclose(file);
+  if (!ok) {
+    throw std::runtime_error("Bad network " + path);
+  }
+  return weights;
+}
+
+void NnueWeights::Save(const std::string& path) const {
+  FILE* file = std::fopen(path.c_str(), "wb");
+  if (!file) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  const uint32_t shape[3] = {kInputs, kHidden, kLayer1};
+  bool ok = std::fwrite(kMagic, sizeof(kMagic), 1, file) == 1 &&
+      std::fwrite(shape, sizeof(shape), 1, file) == 1 &&
+      std::fwrite(&feature, sizeof(feature), 1, file) == 1 &&
+      std::fwrite(&feature_bias, sizeof(feature_bias), 1, file) == 1 &&
+      std::fwrite(&layer1, sizeof(layer1), 1, file) == 1 &&
+      std::fwrite(&layer1_bias, sizeof(layer1_bias), 1, file) == 1 &&
+      std::fwrite(&output, sizeof(output), 1, file) == 1 &&
+      std::fwrite(&output_bias, sizeof(output_bias), 1, file) == 1;
+  ok = std::fclose(file) == 0 && ok;
+  if (!ok) {
+    throw std::runtime_error("Cannot write " + path);
+  }
+}
+
+int NnueEvaluator::Evaluate(const Position& pos) const {
+  NnueAccumulator acc;
+  Refresh(pos.board, acc);
+  return Forward(acc, pos);
+}
+
+std::unique_ptr<EvalStack> NnueEvaluator::NewStack() const {
+  return std::make_unique<NnueStack>(*this, *weights_);
+}
+
+void NnueEvaluator::EvaluateBatch(const PositionBatch& batch, int* scores) const {
+  const Weights& w = *weights_;
+  NnueAccumulator acc;
+  for (size_t i = 0; i < batch.Size(); ++i) {
+    Mask occupied = batch.balls[0][i] | batch.balls[1][i] | batch.balls[2][i];
+    RefreshPlanes(w, {batch.rings[i] & ~occupied, batch.balls[0][i], batch.balls[1][i],
+                      batch.balls[2][i]}, acc);
+    const Column* counts[kCountColumns];
+    for (int pile = 0; pile < Weights::kCountPiles; ++pile) {
+      for (int c = 0; c < kNumColors; ++c) {
+        counts[pile * kNumColors + c] =
+            &w.feature[Weights::CountFeature(pile, c, batch.counts[pile][c][i])];
+      }
+    }
+    scores[i] = Layers(w, acc, counts);
+  }
+}
+
+void NnueEvaluator::Refresh(const BitBoard& board, NnueAccumulator& acc) const {
+  RefreshPlanes(*weights_, Planes(board), acc);
+}
+
+int NnueEvaluator::Forward(const NnueAccumulator& acc, const Position& pos) const {
+  const Weights& w = *weights_;
+  int me = Index(pos.to_move);
+  const Position::Counts* piles[Weights::kCountPiles] = {
+    &pos.supply, &pos.captured[me], &pos.captured[1 - me]};
+  const Column* counts[kCountColumns];
+  for (int pile = 0; pile < Weights::kCountPiles; ++pile) {
+    for (int c = 0; c < kNumColors; ++c) {
+      counts[pile * kNumColors + c] = &w.feature[Weights::CountFeature(pile, c, (*piles[pile])[c])];
+    }
+  }
+  return Layers(w, acc, counts);
+}
+
@@ -0,0 +1,99 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "batch.h"
+#include "evaluation.h"
+
+// Small quantized evaluation network, NNUE style.
+//
+// Inputs are one-hot features: the contents of every cell (vacant ring or
+// a ball of each color) and the ball counts of the supply and of the two
+// players, as seen from the side to move. The first layer is a sum of the
+// weight columns of the active features. The board features change by a
+// few cells per move, so the search keeps that sum (the accumulator) per
+// ply and only adds and subtracts the columns of the changed cells; the
+// count columns are added at evaluation time.
+//
+//   accumulator (int16, kHidden) -> clamp [0, 127] ->
+//   int8 layer (kLayer1) -> (x + bias) >> kLayer1Shift, clamp [0, 127] ->
+//   int8 output -> (x + bias) >> kOutputShift = centipawn-like score.
+//
+// With AVX2 the layers use 256-bit integer kernels, otherwise scalar loops
+// that give the same results.
+//
+// Weights file (little-endian): "ZNN1", u32 kInputs, u32 kHidden,
+// u32 kLayer1, then the arrays of NnueWeights in declaration order.
+
+struct NnueWeights {
+  // Cell contents: vacant ring, white, grey, black.
+  static constexpr int kCellStates = 4;
+  static constexpr int kBoardFeatures = kCellStates * HexGeometry::kMaxCells;
+  // Supply, captures of the side to move, captures of the opponent.
+  static constexpr int kCountPiles = 3;
+  // Counts above this share the last feature.
+  static constexpr int kMaxCount = 15;
+  static constexpr int kCountFeatures = kCountPiles * kNumColors * (kMaxCount + 1);
+  static constexpr int kInputs = kBoardFeatures + kCountFeatures;
+  static constexpr int kHidden = 128;
+  static constexpr int kLayer1 = 32;
+  static constexpr int kLayer1Shift = 6;
+  static constexpr int kOutputShift = 4;
+
+  static int BoardFeature(int state, int cell) { return state * HexGeometry::kMaxCells + cell; }
+  static int CountFeature(int pile, int color, int count) {
+    return kBoardFeatures + (pile * kNumColors + color) * (kMaxCount + 1) +
+        std::min(count, kMaxCount);
+  }
+
+  // Throws std::runtime_error if the file is missing or does not match
+  // the architecture.
+  static std::shared_ptr<NnueWeights> Load(const std::string& path);
+  void Save(const std::string& path) const;
+
+  alignas(32) std::array<std::array<int16_t, kHidden>, kInputs> feature;
+  alignas(32) std::array<int16_t, kHidden> feature_bias;
+  alignas(32) std::array<std::array<int8_t, kHidden>, kLayer1> layer1;
+  alignas(32) std::array<int32_t, kLayer1> layer1_bias;
+  alignas(32) std::array<int8_t, kLayer1> output;
+  int32_t output_bias;
+};
+
+// Active inputs of a batch of positions, e.g. for writing training data:
+// the board features as one mask of cells per cell state and the count
+// features as indices, with one array element per position.
+struct NnueBatchInputs {
+  void Compute(const PositionBatch& batch);
+
+  std::array<std::vector<Mask>, NnueWeights::kCellStates> planes;
+  std::array<std::vector<uint16_t>, NnueWeights::kCountPiles * kNumColors> counts;
+};
+
+struct alignas(32) NnueAccumulator {
+  std::array<int16_t, NnueWeights::kHidden> values;
+};
+
+class NnueEvaluator : public Evaluator {
+ public:
+  explicit NnueEvaluator(std::shared_ptr<const NnueWeights> weights)
+    : weights_(std::move(weights)) {}
+
+  // Evaluates from scratch; the search uses NewStack instead.
+  int Evaluate(const Position& pos) const override;
+
+  std::unique_ptr<EvalStack> NewStack() const override;
+
+  void EvaluateBatch(const PositionBatch& batch, int* scores) const override;
+
+  // Accumulator of the board features of the position.
+  void Refresh(const BitBoard& board, NnueAccumulator& acc) const;
+
+  // Adds the count features and runs the layers after the accumulator.
+  int Forward(const NnueAccumulator& acc, const Position& pos) const;
+
+ private:
+  std::shared_ptr<const NnueWeights> weights_;
+};
@@ -0,0 +1,132 @@
+#pragma once
+#include <optional>
+#include <sstream>
+#include <string>
+
+#include "position.h"
+
+// Text form of positions and moves, used by the command line tools.
+//
+// Position: "<rings> <cells> <supply> <captured1> <captured2> <side> [chain]"
+//   rings     - board variant: 37, 48 or 61;
+//   cells     - one character per cell in linear order: '.' removed ring,
+//               'o' vacant ring, 'w', 'g', 'b' a ball of that color;
+//   supply... - white/grey/black counts, e.g. 6/8/10;
+//   side      - 1 or 2, the player to move;
+//   chain     - optional linear index of the ball that must keep jumping.
+//
+// Move: a placement is "w(3,3)" or "w(3,3)-(0,3)" with the removed ring,
+// a capture is "(2,3)x(4,3)" with the landing cell.
+
+namespace notation {
+
+inline std::string ToString(QR pos) {
+  return "(" + std::to_string(pos.q) + "," + std::to_string(pos.r) + ")";
+}
+
+inline char ColorChar(BallColor color) {
+  return "wgb"[Index(color)];
+}
+
+inline std::string ToString(const Position& pos, Move move) {
+  const auto& geometry = pos.Geometry();
+  if (move.IsCapture()) {
+    int land = geometry.jumps[move.From()][move.Direction()];
+    return ToString(geometry.CellQR(move.From())) + "x" + ToString(geometry.CellQR(land));
+  }
+  std::string res = ColorChar(move.Color()) + ToString(geometry.CellQR(move.Cell()));
+  if (move.RemovedRing() != Move::kNoRing) {
+    res += "-" + ToString(geometry.CellQR(move.RemovedRing()));
+  }
+  return res;
+}
+
+inline std::string ToString(const Position::Counts& counts) {
+  return std::to_string(counts[0]) + "/" + std::to_string(counts[1]) + "/" +
+      std::to_string(counts[2]);
+}
+
+inline std::string ToString(const Position& pos) {
+  const auto& geometry = pos.Geometry();
+  std::string cells;
+  for (int i = 0; i < geometry.num_cells; ++i) {
+    auto color = pos.board.ColorAt(i);
+    cells += color ? ColorChar(*color) : pos.board.HasRing(i) ? 'o' : '.';
+  }
+  std::string res = std::to_string(geometry.num_cells) + " " + cells + " " +
+      ToString(pos.supply) + " " + ToString(pos.captured[0]) + " " +
+      ToString(pos.captured[1]) + " " + (pos.to_move == PlayerId::kPlayer1 ? "1" : "2");
+  if (pos.chain_cell != HexGeometry::kNoCell) {
+    res += " " + std::to_string(pos.chain_cell);
+  }
+  return res;
+}
+
+inline std::optional<Position::Counts> CountsFromString(const std::string& str) {
+  Position::Counts counts{};
+  int w, g, b;
+  char s1, s2;
+  std::istringstream in(str);
+  if (!(in >> w >> s1 >> g >> s2 >> b) || s1 != '/' || s2 != '/') {
+    return std::nullopt;
+  }
+  counts[0] = w;
+  counts[1] = g;
+  counts[2] = b;
+  return counts;
+}
+
+inline std::optional<Position> PositionFromString(const std::string& str) {
+  std::istringstream in(str);
+  int rings, side;
+  std::string cells, supply, captured1, captured2;
+  if (!(in >> rings >> cells >> supply >> captured1 >> captured2 >> side)) {
+    return std::nullopt;
+  }
+
+  BoardVariant variant;
+  switch (rings) {
+    case 37: variant = BoardVariant::kRings37; break;
+    case 48: variant = BoardVariant::kRings48; break;
+    case 61: variant = BoardVariant::kRings61; break;
+    default: return std::nullopt;
+  }
+
+  Position pos(variant);
+  if (static_cast<int>(cells.size()) != pos.Geometry().num_cells) {
+    return std::nullopt;
+  }
+  for (int i = 0; i < pos.Geometry().num_cells; ++i) {
+    switch (cells[i]) {
+      case '.': pos.board.RemoveRing(i); break;
+      case 'o': break;
+      case 'w': pos.board.Place(i, BallColor::kWhite); break;
+      case 'g': pos.board.Place(i, BallColor::kGrey); break;
+      case 'b': pos.board.Place(i, BallColor::kBlack); break;
+      default: return std::nullopt;
+    }
+  }
+
+  auto s = CountsFromString(supply);
+  auto c1 = CountsFromString(captured1);
+  auto c2 = CountsFromString(captured2);
+  if (!s || !c1 || !c2 || (side != 1 && side != 2)) {
+    return std::nullopt;
+  }
+  pos.supply = *s;
+  pos.captured[0] = *c1;
+  pos.captured[1] = *c2;
+  pos.to_move = side == 1 ? PlayerId::kPlayer1 : PlayerId::kPlayer2;
+
+  int chain;
+  if (in >> chain) {
+    if (chain < 0 || chain >= pos.Geometry().num_cells || !pos.board.HasBall(chain)) {
+      return std::nullopt;
+    }
+    pos.chain_cell = chain;
+  }
+  pos.hash = pos.ComputeHash();
+  return pos;
+}
+
+}  // namespace notation
@@ -0,0 +1,119 @@
+// Headless move generation benchmark and correctness check.
+//
+// Usage: zertz_perft <depth> [positions file] [--divide]
+//
+// Counts leaf nodes of the game tree to the given depth (one jump of a
+// capture chain is one ply) from the initial position, or from every
+// position of the file (one per line in notation.h format, '#' comments).
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "movegen.h"
+#include "notation.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t Perft(Position& pos, int depth) {
+  MoveList moves;
+  GenerateMoves(pos, moves);
+  if (depth == 1) {
+    return moves.Size();
+  }
+  uint64_t nodes = 0;
+  for (Move move : moves) {
+    auto undo = pos.MakeMove(move);
+    nodes += Perft(pos, depth - 1);
+    pos.UnmakeMove(move, undo);
+  }
+  return nodes;
+}
+
+void Divide(Position& pos, int depth) {
+  MoveList moves;
+  GenerateMoves(pos, moves);
+  for (Move move : moves) {
+    auto undo = pos.MakeMove(move);
+    uint64_t nodes = depth > 1 ? Perft(pos, depth - 1) : 1;
+    pos.UnmakeMove(move, undo);
+    std::cout << "  " << notation::ToString(pos, move) << ": " << nodes << "\n";
+  }
+}
+
+void Run(Position pos, int max_depth, bool divide) {
+  std::cout << notation::ToString(pos) << "\n";
+  uint64_t total_nodes = 0;
+  double total_seconds = 0.0;
+  for (int depth = 1; depth <= max_depth; ++depth) {
+    auto start = Clock::now();
+    uint64_t nodes = Perft(pos, depth);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    total_nodes += nodes;
+    total_seconds += seconds;
+    std::cout << "depth " << depth << ": " << nodes << " nodes, "
+              << seconds << " s, "
+              << static_cast<uint64_t>(nodes / std::max(seconds, 1e-9)) << " nodes/s\n";
+  }
+  std::cout << "total: " << total_nodes << " nodes, " << total_seconds << " s, "
+            << static_cast<uint64_t>(total_nodes / std::max(total_seconds, 1e-9))
+            << " nodes/s\n";
+  if (divide) {
+    Divide(pos, max_depth);
+  }
+}
+
+}
+
+int main(int argc, char** argv) {
+  int depth = 0;
+  bool divide = false;
+  std::string path;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--divide") == 0) {
+      divide = true;
+    } else if (depth == 0) {
+      depth = std::atoi(argv[i]);
+    } else {
+      path = argv[i];
+    }
+  }
+  if (depth <= 0) {
+    std::cerr << "Usage: " << argv[0] << " <depth> [positions file] [--divide]\n";
+    return 1;
+  }
+
+  if (path.empty()) {
+    Run(Position(), depth, divide);
+    return 0;
+  }
+
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "Cannot open " << path << "\n";
+    return 1;
+  }
+  std::string line;
+  int line_no = 0;
+  while (std::getline(in, line)) {
+    ++line_no;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    auto pos = notation::PositionFromString(line);
+    if (!pos) {
+      std::cerr << path << ":" << line_no << ": bad position\n";
+      return 1;
+    }
+    Run(*pos, depth, divide);
+  }
+  return 0;
+}
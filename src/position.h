@@ -0,0 +1,323 @@
+#pragma once
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <optional>
+
+#include "bitboard.h"
+#include "isolation.h"
+#include "structures.h"
+#include "zertz.h"
+#include "zobrist.h"
+
+// Compact game position used by the engine: bitboards plus ball counts.
+// Unlike Zertz::GameState it knows whose turn it is and does not track
+// individual balls, so it is cheap to copy and to update in place.
+
+// A move fits into 16 bits.
+// Placement: [15] = 0, [13:12] color, [11:6] removed ring, [5:0] cell.
+// Capture (a single jump): [15] = 1, [8:6] direction, [5:0] jumping ball.
+// Multi-jump captures are played as a chain of single jumps by the same
+// player, see Position::chain_cell.
+class Move {
+ public:
+  static constexpr int kNoRing = 63;
+
+  Move() = default;
+
+  static Move Placement(BallColor color, int cell, int removed_ring) {
+    return Move((static_cast<int>(color) << 12) | (removed_ring << 6) | cell);
+  }
+
+  static Move Capture(int from, int direction) {
+    return Move(kCaptureFlag | (direction << 6) | from);
+  }
+
+  static Move FromRaw(uint16_t raw) { return Move(raw); }
+  static Move None() { return Move(0xFFFF); }
+
+  bool IsCapture() const { return data_ & kCaptureFlag; }
+
+  int Cell() const { return data_ & 63; }
+  int From() const { return data_ & 63; }
+  int RemovedRing() const { return (data_ >> 6) & 63; }
+  int Direction() const { return (data_ >> 6) & 7; }
+  BallColor Color() const { return static_cast<BallColor>((data_ >> 12) & 3); }
+
+  uint16_t Raw() const { return data_; }
+
+  friend bool operator==(Move left, Move right) { return left.data_ == right.data_; }
+  friend bool operator!=(Move left, Move right) { return left.data_ != right.data_; }
+
+ private:
+  static constexpr uint16_t kCaptureFlag = 1 << 15;
+
+  explicit Move(int data) : data_(static_cast<uint16_t>(data)) {}
+
+  uint16_t data_;
+};
+
+inline int Index(PlayerId player) { return static_cast<int>(player); }
+inline int Index(BallColor color) { return static_cast<int>(color); }
+
+inline PlayerId Opponent(PlayerId player) {
+  return player == PlayerId::kPlayer1 ? PlayerId::kPlayer2 : PlayerId::kPlayer1;
+}
+
+struct Position {
+  using Counts = std::array<uint8_t, kNumColors>;
+
+  // What MakeMove needs to remember to take the move back.
+  struct UndoInfo {
+    PlayerId to_move;
+    int8_t chain_cell;
+    bool from_captured = false;
+    BallColor jumped = BallColor::kWhite;
+    // Balls of the isolated groups claimed by the move, per color.
+    std::array<Mask, kNumColors> claimed{};
+    uint64_t hash;
+  };
+
+  explicit Position(BoardVariant variant = BoardVariant::kRings37)
+    : board(HexGeometry::Get(variant)) {
+    auto initial = InitialSupply(variant);
+    for (int c = 0; c < kNumColors; ++c) {
+      supply[c] = initial[c];
+    }
+    hash = ComputeHash();
+  }
+
+  // Builds the position from a GUI game state.
+  static Position FromState(const ZState& state, PlayerId to_move) {
+    Position pos;
+    pos.board = state.board.Bits();
+    for (int c = 0; c < kNumColors; ++c) {
+      auto color = static_cast<BallColor>(c);
+      pos.supply[c] = state.GetPile(PileId::kTable).Count(color);
+      pos.captured[0][c] = state.GetPile(PileId::kPlayer1).Count(color);
+      pos.captured[1][c] = state.GetPile(PileId::kPlayer2).Count(color);
+    }
+    pos.to_move = to_move;
+    pos.hash = state.hash ^ (to_move == PlayerId::kPlayer2 ? ZobristKeys::Get().side : 0);
+    assert(pos.hash == pos.ComputeHash());
+    return pos;
+  }
+
+  const HexGeometry& Geometry() const { return *board.geometry; }
+
+  // Zobrist key from scratch. MakeMove keeps `hash` equal to it.
+  uint64_t ComputeHash() const {
+    const auto& keys = ZobristKeys::Get();
+    uint64_t h = 0;
+    for (int cell : SetBits{board.rings}) {
+      h ^= keys.ring[cell];
+    }
+    for (int c = 0; c < kNumColors; ++c) {
+      for (int cell : SetBits{board.balls[c]}) {
+        h ^= keys.ball[c][cell];
+      }
+      h ^= keys.count[kSupplyPile][c][supply[c]];
+      h ^= keys.count[CapturePile(0)][c][captured[0][c]];
+      h ^= keys.count[CapturePile(1)][c][captured[1][c]];
+    }
+    if (to_move == PlayerId::kPlayer2) {
+      h ^= keys.side;
+    }
+    if (chain_cell != HexGeometry::kNoCell) {
+      h ^= keys.chain[chain_cell];
+    }
+    return h;
+  }
+
+  bool SupplyEmpty() const { return (supply[0] | supply[1] | supply[2]) == 0; }
+
+  // Balls a player may place: the supply, or own captures once it runs out.
+  const Counts& Reserve(PlayerId player) const {
+    return SupplyEmpty() ? captured[Index(player)] : supply;
+  }
+
+  static bool HasWon(const Counts& c) {
+    return c[0] >= 4 || c[1] >= 5 || c[2] >= 6 ||
+        (c[0] >= 3 && c[1] >= 3 && c[2] >= 3);
+  }
+
+  std::optional<PlayerId> Winner() const {
+    if (HasWon(captured[0])) {
+      return PlayerId::kPlayer1;
+    }
+    if (HasWon(captured[1])) {
+      return PlayerId::kPlayer2;
+    }
+    return std::nullopt;
+  }
+
+  // Whether the ball on the cell can jump over a neighbor.
+  template <BoardVariant V>
+  bool CanCapture(int cell) const {
+    using Tables = HexTables<V>;
+    Mask occupied = board.Occupied();
+    Mask vacant = board.Vacant();
+    for (int d = 0; d < kNumDirections; ++d) {
+      int over = Tables::kNeighbors[cell][d];
+      if (over == kNoCell || !(occupied & Bit(over))) {
+        continue;
+      }
+      int land = Tables::kJumps[cell][d];
+      if (land != kNoCell && (vacant & Bit(land))) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool CanCapture(int cell) const {
+    return WithVariant(board.Variant(), [&] (auto tag) {
+      return CanCapture<decltype(tag)::value>(cell);
+    });
+  }
+
+  UndoInfo MakeMove(Move move) {
+    return WithVariant(board.Variant(), [&] (auto tag) {
+      return MakeMove<decltype(tag)::value>(move);
+    });
+  }
+
+  void UnmakeMove(Move move, const UndoInfo& undo) {
+    WithVariant(board.Variant(), [&] (auto tag) {
+      UnmakeMove<decltype(tag)::value>(move, undo);
+    });
+  }
+
+  // MakeMove and UnmakeMove specialized for the board variant.
+  template <BoardVariant V>
+  UndoInfo MakeMove(Move move) {
+    using Tables = HexTables<V>;
+    UndoInfo undo{.to_move = to_move, .chain_cell = chain_cell, .hash = hash};
+    const auto& keys = ZobristKeys::Get();
+    int me = Index(to_move);
+    if (chain_cell != HexGeometry::kNoCell) {
+      hash ^= keys.chain[chain_cell];
+    }
+    if (move.IsCapture()) {
+      int from = move.From();
+      int over = Tables::kNeighbors[from][move.Direction()];
+      int land = Tables::kJumps[from][move.Direction()];
+      BallColor color = *board.ColorAt(from);
+      undo.jumped = *board.ColorAt(over);
+      ClearBall(from, color);
+      PlaceBall(land, color);
+      ClearBall(over, undo.jumped);
+      AddCount(CapturePile(me), captured[me], Index(undo.jumped), 1);
+      if (CanCapture<V>(land)) {
+        chain_cell = land;
+        hash ^= keys.chain[land];
+        return undo;
+      }
+    } else {
+      int c = Index(move.Color());
+      undo.from_captured = SupplyEmpty();
+      if (undo.from_captured) {
+        AddCount(CapturePile(me), captured[me], c, -1);
+      } else {
+        AddCount(kSupplyPile, supply, c, -1);
+      }
+      PlaceBall(move.Cell(), move.Color());
+      int removed = HexGeometry::kNoCell;
+      if (move.RemovedRing() != Move::kNoRing) {
+        removed = move.RemovedRing();
+        board.RemoveRing(removed);
+        hash ^= keys.ring[removed];
+      }
+      Mask group = ClaimableGroups<V>(board, move.Cell(), removed);
+      if (group) {
+        Claim(group, undo);
+      }
+    }
+    chain_cell = HexGeometry::kNoCell;
+    to_move = Opponent(to_move);
+    hash ^= keys.side;
+    return undo;
+  }
+
+  template <BoardVariant V>
+  void UnmakeMove(Move move, const UndoInfo& undo) {
+    using Tables = HexTables<V>;
+    to_move = undo.to_move;
+    chain_cell = undo.chain_cell;
+    int me = Index(to_move);
+    if (move.IsCapture()) {
+      int from = move.From();
+      int over = Tables::kNeighbors[from][move.Direction()];
+      int land = Tables::kJumps[from][move.Direction()];
+      BallColor color = *board.ColorAt(land);
+      --captured[me][Index(undo.jumped)];
+      board.Place(over, undo.jumped);
+      board.Clear(land, color);
+      board.Place(from, color);
+    } else {
+      Unclaim(undo);
+      if (move.RemovedRing() != Move::kNoRing) {
+        board.RestoreRing(move.RemovedRing());
+      }
+      board.Clear(move.Cell(), move.Color());
+      auto& reserve = undo.from_captured ? captured[me] : supply;
+      ++reserve[Index(move.Color())];
+    }
+    hash = undo.hash;
+  }
+
+  // Takes the isolated group off the board, the mover gets its balls.
+  void Claim(Mask group, UndoInfo& undo) {
+    const auto& keys = ZobristKeys::Get();
+    int me = Index(to_move);
+    for (int c = 0; c < kNumColors; ++c) {
+      undo.claimed[c] = board.balls[c] & group;
+      for (int cell : SetBits{undo.claimed[c]}) {
+        hash ^= keys.ball[c][cell] ^ keys.ring[cell];
+      }
+      AddCount(CapturePile(me), captured[me], c, PopCount(undo.claimed[c]));
+      board.balls[c] &= ~group;
+    }
+    board.rings &= ~group;
+  }
+
+  void Unclaim(const UndoInfo& undo) {
+    int me = Index(to_move);
+    for (int c = 0; c < kNumColors; ++c) {
+      captured[me][c] -= PopCount(undo.claimed[c]);
+      board.balls[c] |= undo.claimed[c];
+      board.rings |= undo.claimed[c];
+    }
+  }
+
+  void PlaceBall(int cell, BallColor color) {
+    board.Place(cell, color);
+    hash ^= ZobristKeys::Get().ball[Index(color)][cell];
+  }
+
+  void ClearBall(int cell, BallColor color) {
+    board.Clear(cell, color);
+    hash ^= ZobristKeys::Get().ball[Index(color)][cell];
+  }
+
+  void AddCount(int pile, Counts& counts, int color, int delta) {
+    const auto& keys = ZobristKeys::Get().count[pile][color];
+    hash ^= keys[counts[color]];
+    counts[color] += delta;
+    hash ^= keys[counts[color]];
+  }
+
+  // Zobrist pile indices.
+  static constexpr int kSupplyPile = 0;
+  static constexpr int CapturePile(int player) { return 1 + player; }
+
+  BitBoard board;
+  Counts supply{};
+  std::array<Counts, 2> captured{};
+  PlayerId to_move = PlayerId::kPlayer1;
+  // Cell of the ball that has just jumped and must keep capturing,
+  // HexGeometry::kNoCell if the turn is not in the middle of a chain.
+  int8_t chain_cell = HexGeometry::kNoCell;
+  // Zobrist key, see ZobristKeys.
+  uint64_t hash = 0;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <SFML/Graphics.hpp>
+
+// Decides when the window has to be drawn again. A frame is drawn after
+// input events, when the game state version changes, while an animation is
+// running and when another thread asks for it (e.g. engine progress).
+// Otherwise the main loop sleeps: in waitEvent, or in a timed wait while
+// other threads may request redraws.
+class RenderScheduler {
+ public:
+  // Frame period while animating or polling for redraw requests.
+  static constexpr int kFrameMs = 16;
+
+  // Thread-safe.
+  void RequestRedraw() { redraw_requested_ = true; }
+
+  // While set, the window is redrawn every frame.
+  void SetAnimating(bool animating) { animating_ = animating; }
+
+  // Number of threads that may call RequestRedraw; while non-zero the loop
+  // cannot block in waitEvent. Thread-safe.
+  void AddRedrawSource() { ++redraw_sources_; }
+  void RemoveRedrawSource() { --redraw_sources_; }
+
+  // Waits until there is an event or a reason to redraw the state version.
+  // Returns true if `event` was filled.
+  bool Wait(sf::RenderWindow& win, sf::Event& event, uint64_t version) {
+    if (win.pollEvent(event)) {
+      return true;
+    }
+    if (animating_ || redraw_requested_ || drawn_version_ != version + 1) {
+      return false;
+    }
+    // Sources are read before the request: a source that goes away requests
+    // its last redraw first, and that request is then seen here.
+    if (redraw_sources_ == 0 && !redraw_requested_) {
+      return win.waitEvent(event);
+    }
+    while (!redraw_requested_) {
+      sf::sleep(sf::milliseconds(kFrameMs));
+      if (win.pollEvent(event)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Whether a frame has to be drawn for the state version, given whether
+  // input arrived since the last frame.
+  bool NeedsRedraw(uint64_t version, bool had_input) {
+    return had_input || animating_ || redraw_requested_.exchange(false) ||
+        drawn_version_ != version + 1;
+  }
+
+  void OnDrawn(uint64_t version) { drawn_version_ = version + 1; }
+
+ private:
+  std::atomic<bool> redraw_requested_{false};
+  std::atomic<int> redraw_sources_{0};
+  bool animating_ = false;
+  // Version of the last drawn state plus one, 0 before the first frame.
+  uint64_t drawn_version_ = 0;
+};
@@ -0,0 +1,392 @@
+#include "search.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+using Bound = TranspositionTable::Bound;
+
+const int kAspirationWindow = 40;
+const int kHistoryLimit = 1 << 14;
+
+const int16_t kTTMoveScore = 32000;
+const int16_t kKillerScore = 31000;
+
+}
+
+Searcher::Searcher(TranspositionTable& tt, const Evaluator& evaluator, std::atomic<bool>& stop)
+  : tt_(tt)
+  , evaluator_(evaluator)
+  , eval_stack_(evaluator.NewStack())
+  , stop_(stop)
+  , frames_(kMaxPly + 1)
+  , history_(1 << 16) {
+  ClearTables();
+}
+
+void Searcher::SetPosition(const Position& pos) {
+  pos_ = pos;
+  if (eval_stack_) {
+    eval_stack_->Reset(pos_);
+  }
+}
+
+void Searcher::SetLimits(std::optional<TimePoint> deadline, uint64_t max_nodes) {
+  deadline_ = deadline;
+  max_nodes_ = max_nodes;
+}
+
+void Searcher::ClearTables() {
+  for (auto& killers : killers_) {
+    killers.fill(Move::None());
+  }
+  std::fill(history_.begin(), history_.end(), 0);
+}
+
+std::vector<Move> Searcher::PrincipalVariation() const {
+  return std::vector<Move>(pv_[0].begin(), pv_[0].begin() + pv_length_[0]);
+}
+
+int Searcher::SearchRoot(int depth, int alpha, int beta) {
+  return Negamax(depth, 0, alpha, beta);
+}
+
+bool Searcher::ShouldStop() {
+  uint64_t nodes = Nodes();
+  if ((nodes & 2047) == 0) {
+    if ((max_nodes_ && nodes >= max_nodes_) ||
+        (deadline_ && std::chrono::steady_clock::now() >= *deadline_)) {
+      stop_ = true;
+    }
+  }
+  return stop_.load(std::memory_order_relaxed);
+}
+
+int Searcher::TerminalScore(int ply) const {
+  auto winner = pos_.Winner();
+  if (winner && *winner == pos_.to_move) {
+    return kWinScore - ply;
+  }
+  // Lost, or no legal moves left.
+  return -(kWinScore - ply);
+}
+
+int Searcher::SearchChild(int depth, int ply, int alpha, int beta, bool same_side) {
+  if (same_side) {
+    return Negamax(depth, ply, alpha, beta);
+  }
+  return -Negamax(depth, ply, -beta, -alpha);
+}
+
+int Searcher::Negamax(int depth, int ply, int alpha, int beta) {
+  pv_length_[ply] = 0;
+  if (depth <= 0) {
+    return Quiesce(ply, alpha, beta);
+  }
+  CountNode();
+  if (ply > 0 && ShouldStop()) {
+    return 0;
+  }
+  if (pos_.Winner()) {
+    return TerminalScore(ply);
+  }
+  // The ring count rules out most positions before the table is touched.
+  if (ply > 0 && tablebase_ &&
+      PopCount(pos_.board.rings) <= tablebase_->Index().MaxRings()) {
+    if (auto result = tablebase_->Probe(pos_)) {
+      return TablebaseScore(*result);
+    }
+  }
+  if (ply >= kMaxPly - 1) {
+    return Evaluate();
+  }
+
+  TranspositionTable::Entry entry;
+  Move tt_move = Move::None();
+  if (tt_.Probe(pos_.hash, ply, entry)) {
+    tt_move = entry.move;
+    if (ply > 0 && entry.depth >= depth &&
+        (entry.bound == Bound::kExact ||
+         (entry.bound == Bound::kLower && entry.score >= beta) ||
+         (entry.bound == Bound::kUpper && entry.score <= alpha))) {
+      return entry.score;
+    }
+  }
+
+  Frame& frame = frames_[ply];
+  GenerateMoves(pos_, frame.moves);
+  if (frame.moves.Empty()) {
+    return TerminalScore(ply);
+  }
+  ScoreMoves(frame, ply, tt_move);
+
+  const int original_alpha = alpha;
+  const PlayerId us = pos_.to_move;
+  int best_score = -kInfinity;
+  Move best_move = Move::None();
+  for (int i = 0; i < frame.moves.Size(); ++i) {
+    Move move = PickNext(frame, i);
+    auto undo = MakeMove(move);
+    bool same_side = pos_.to_move == us;
+    int score;
+    if (i == 0) {
+      score = SearchChild(depth - 1, ply + 1, alpha, beta, same_side);
+    } else {
+      score = SearchChild(depth - 1, ply + 1, alpha, alpha + 1, same_side);
+      if (score > alpha && score < beta) {
+        score = SearchChild(depth - 1, ply + 1, alpha, beta, same_side);
+      }
+    }
+    UnmakeMove(move, undo);
+    if (stop_.load(std::memory_order_relaxed)) {
+      return 0;
+    }
+
+    if (score > best_score) {
+      best_score = score;
+      best_move = move;
+      if (score > alpha) {
+        alpha = score;
+        UpdatePV(ply, move);
+        if (alpha >= beta) {
+          UpdateOrdering(move, depth, ply);
+          break;
+        }
+      }
+    }
+  }
+
+  Bound bound = best_score >= beta ? Bound::kLower
+      : best_score > original_alpha ? Bound::kExact : Bound::kUpper;
+  tt_.Store(pos_.hash, ply, best_move, best_score, depth, bound);
+  return best_score;
+}
+
+// Captures are mandatory, so they are searched to the end before the static
+// evaluation is trusted.
+int Searcher::Quiesce(int ply, int alpha, int beta) {
+  CountNode();
+  if (ShouldStop()) {
+    return 0;
+  }
+  if (pos_.Winner()) {
+    return TerminalScore(ply);
+  }
+  if (ply >= kMaxPly - 1) {
+    return Evaluate();
+  }
+
+  Frame& frame = frames_[ply];
+  frame.moves.Clear();
+  GenerateCaptures(pos_, frame.moves);
+  if (frame.moves.Empty()) {
+    return Evaluate();
+  }
+
+  const PlayerId us = pos_.to_move;
+  int best_score = -kInfinity;
+  for (Move move : frame.moves) {
+    auto undo = MakeMove(move);
+    bool same_side = pos_.to_move == us;
+    int score = same_side ? Quiesce(ply + 1, alpha, beta) : -Quiesce(ply + 1, -beta, -alpha);
+    UnmakeMove(move, undo);
+    if (stop_.load(std::memory_order_relaxed)) {
+      return 0;
+    }
+    if (score > best_score) {
+      best_score = score;
+      if (score > alpha) {
+        alpha = score;
+        if (alpha >= beta) {
+          break;
+        }
+      }
+    }
+  }
+  return best_score;
+}
+
+void Searcher::ScoreMoves(Frame& frame, int ply, Move tt_move) const {
+  for (int i = 0; i < frame.moves.Size(); ++i) {
+    Move move = frame.moves[i];
+    if (move == tt_move) {
+      frame.scores[i] = kTTMoveScore;
+    } else if (move == killers_[ply][0]) {
+      frame.scores[i] = kKillerScore;
+    } else if (move == killers_[ply][1]) {
+      frame.scores[i] = kKillerScore - 1;
+    } else {
+      frame.scores[i] = static_cast<int16_t>(history_[move.Raw()]);
+    }
+  }
+}
+
+// Selection sort step: good moves usually cut off early, so the rest of the
+// list is never sorted.
+Move Searcher::PickNext(Frame& frame, int i) const {
+  int best = i;
+  for (int j = i + 1; j < frame.moves.Size(); ++j) {
+    if (frame.scores[j] > frame.scores[best]) {
+      best = j;
+    }
+  }
+  std::swap(frame.moves[i], frame.moves[best]);
+  std::swap(frame.scores[i], frame.scores[best]);
+  return frame.moves[i];
+}
+
+void Searcher::UpdateOrdering(Move move, int depth, int ply) {
+  if (!move.IsCapture() && killers_[ply][0] != move) {
+    killers_[ply][1] = killers_[ply][0];
+    killers_[ply][0] = move;
+  }
+  int32_t& h = history_[move.Raw()];
+  h += depth * depth;
+  if (h >= kHistoryLimit) {
+    for (auto& value : history_) {
+      value /= 2;
+    }
+  }
+}
+
+void Searcher::UpdatePV(int ply, Move move) {
+  pv_[ply][0] = move;
+  int child = ply + 1 < kMaxPly ? pv_length_[ply + 1] : 0;
+  for (int i = 0; i < child; ++i) {
+    pv_[ply][i + 1] = pv_[ply + 1][i];
+  }
+  pv_length_[ply] = child + 1;
+}
+
+Engine::Engine(std::shared_ptr<const Evaluator> evaluator, size_t tt_megabytes,
+               int threads)
+  : evaluator_(std::move(evaluator))
+  , tt_(tt_megabytes) {
+  SetThreads(threads);
+}
+
+void Engine::SetThreads(int threads) {
+  searchers_.clear();
+  for (int i = 0; i < std::max(threads, 1); ++i) {
+    searchers_.push_back(std::make_unique<Searcher>(tt_, *evaluator_, stop_));
+  }
+}
+
+void Engine::NewGame() {
+  tt_.Clear();
+  for (auto& searcher : searchers_) {
+    searcher->ClearTables();
+  }
+}
+
+uint64_t Engine::TotalNodes() const {
+  uint64_t nodes = 0;
+  for (const auto& searcher : searchers_) {
+    nodes += searcher->Nodes();
+  }
+  return nodes;
+}
+
+SearchInfo Engine::Search(const Position& pos, const SearchLimits& limits,
+                          const Callback& on_iteration) {
+  if (book_) {
+    if (auto move = book_->BestMove(pos, book_min_games_)) {
+      SearchInfo result;
+      result.pv = {*move};
+      if (on_iteration) {
+        on_iteration(result);
+      }
+      return result;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::optional<Searcher::TimePoint> deadline;
+  if (limits.time_ms > 0) {
+    deadline = start + std::chrono::milliseconds(limits.time_ms);
+  }
+
+  stop_ = false;
+  for (size_t i = 0; i < searchers_.size(); ++i) {
+    searchers_[i]->SetPosition(pos);
+    searchers_[i]->SetTablebase(tablebase_.get());
+    searchers_[i]->ResetNodes();
+    // Only the main thread watches the limits.
+    if (i == 0) {
+      searchers_[i]->SetLimits(deadline, limits.nodes);
+    } else {
+      searchers_[i]->SetLimits(std::nullopt, 0);
+    }
+  }
+
+  std::vector<std::thread> helpers;
+  for (int i = 1; i < Threads(); ++i) {
+    helpers.emplace_back([this, i, &limits, start] {
+      IterativeDeepening(i, limits, start, {});
+    });
+  }
+  SearchInfo result = IterativeDeepening(0, limits, start, on_iteration);
+  stop_ = true;
+  for (auto& helper : helpers) {
+    helper.join();
+  }
+
+  result.nodes = TotalNodes();
+  result.seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+SearchInfo Engine::IterativeDeepening(int thread_idx, const SearchLimits& limits,
+                                      std::chrono::steady_clock::time_point start,
+                                      const Callback& on_iteration) {
+  Searcher& searcher = *searchers_[thread_idx];
+  const bool main = thread_idx == 0;
+  SearchInfo result;
+  int max_depth = std::min(limits.depth, kMaxPly - 1);
+  for (int depth = 1 + (main ? 0 : thread_idx % 2); depth <= max_depth; ++depth) {
+    int alpha = -kInfinity;
+    int beta = kInfinity;
+    int delta = kAspirationWindow;
+    if (depth >= 4 && !IsWinScore(result.score)) {
+      alpha = result.score - delta;
+      beta = result.score + delta;
+    }
+
+    int score;
+    while (true) {
+      score = searcher.SearchRoot(depth, alpha, beta);
+      if (stop_) {
+        break;
+      }
+      if (score <= alpha) {
+        alpha = std::max(alpha - delta, -kInfinity);
+      } else if (score >= beta) {
+        beta = std::min(beta + delta, kInfinity);
+      } else {
+        break;
+      }
+      delta *= 2;
+    }
+    if (stop_ && result.depth > 0) {
+      break;
+    }
+
+    result.depth = depth;
+    result.score = score;
+    result.pv = searcher.PrincipalVariation();
+    if (main) {
+      result.nodes = TotalNodes();
+      result.seconds = std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start).count();
+      if (on_iteration) {
+        on_iteration(result);
+      }
+    }
+    if (result.pv.empty() || stop_) {
+      break;
+    }
+  }
+  return result;
+}
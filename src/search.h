@@ -0,0 +1,180 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "book.h"
+#include "evaluation.h"
+#include "movegen.h"
+#include "position.h"
+#include "tablebase.h"
+#include "tt.h"
+
+// Negamax alpha-beta search with iterative deepening, aspiration windows,
+// a transposition table and killer/history move ordering. Runs on several
+// threads in Lazy SMP fashion: every thread searches the same root with its
+// own ordering tables and they only share the transposition table.
+
+struct SearchLimits {
+  int depth = kMaxPly - 1;
+  // Zero means no limit.
+  int64_t time_ms = 0;
+  uint64_t nodes = 0;
+};
+
+struct SearchInfo {
+  int depth = 0;
+  int score = 0;
+  uint64_t nodes = 0;
+  double seconds = 0.0;
+  std::vector<Move> pv;
+
+  uint64_t Nps() const {
+    return seconds > 0.0 ? static_cast<uint64_t>(nodes / seconds) : 0;
+  }
+
+  Move BestMove() const { return pv.empty() ? Move::None() : pv.front(); }
+};
+
+// Search state of a single thread: its copy of the position, move ordering
+// tables and the principal variation.
+class Searcher {
+ public:
+  using TimePoint = std::chrono::steady_clock::time_point;
+
+  Searcher(TranspositionTable& tt, const Evaluator& evaluator, std::atomic<bool>& stop);
+
+  void SetPosition(const Position& pos);
+
+  // Probed below the root, may be null.
+  void SetTablebase(const Tablebase* tablebase) { tablebase_ = tablebase; }
+
+  // Stops the search (sets the shared flag) once the deadline or the node
+  // budget is exceeded.
+  void SetLimits(std::optional<TimePoint> deadline, uint64_t max_nodes);
+
+  // Searches the root to the given depth inside (alpha, beta).
+  int SearchRoot(int depth, int alpha, int beta);
+
+  std::vector<Move> PrincipalVariation() const;
+  // Safe to read from other threads while searching.
+  uint64_t Nodes() const { return nodes_.load(std::memory_order_relaxed); }
+  void ResetNodes() { nodes_.store(0, std::memory_order_relaxed); }
+
+  // Forgets killers and history, e.g. between games.
+  void ClearTables();
+
+ private:
+  struct Frame {
+    MoveList moves;
+    std::array<int16_t, MoveList::kCapacity> scores;
+  };
+
+  int Negamax(int depth, int ply, int alpha, int beta);
+  int Quiesce(int ply, int alpha, int beta);
+
+  // Searches the position after a move. Capture chains keep the side to
+  // move, in which case the score is not negated.
+  int SearchChild(int depth, int ply, int alpha, int beta, bool same_side);
+
+  int TerminalScore(int ply) const;
+  int Evaluate() {
+    return eval_stack_ ? eval_stack_->Evaluate(pos_) : evaluator_.Evaluate(pos_);
+  }
+  // MakeMove and UnmakeMove of the position that keep the evaluation
+  // stack on the same path.
+  Position::UndoInfo MakeMove(Move move) {
+    auto undo = pos_.MakeMove(move);
+    if (eval_stack_) {
+      eval_stack_->Push(pos_);
+    }
+    return undo;
+  }
+  void UnmakeMove(Move move, const Position::UndoInfo& undo) {
+    pos_.UnmakeMove(move, undo);
+    if (eval_stack_) {
+      eval_stack_->Pop();
+    }
+  }
+  void ScoreMoves(Frame& frame, int ply, Move tt_move) const;
+  Move PickNext(Frame& frame, int i) const;
+  void UpdateOrdering(Move move, int depth, int ply);
+  void UpdatePV(int ply, Move move);
+  bool ShouldStop();
+  void CountNode() {
+    nodes_.store(nodes_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  TranspositionTable& tt_;
+  const Evaluator& evaluator_;
+  std::unique_ptr<EvalStack> eval_stack_;
+  std::atomic<bool>& stop_;
+  const Tablebase* tablebase_ = nullptr;
+
+  Position pos_;
+  std::optional<TimePoint> deadline_;
+  uint64_t max_nodes_ = 0;
+  std::atomic<uint64_t> nodes_{0};
+
+  std::vector<Frame> frames_;
+  std::array<std::array<Move, 2>, kMaxPly> killers_;
+  std::vector<int32_t> history_;
+  std::array<std::array<Move, kMaxPly>, kMaxPly> pv_;
+  std::array<int, kMaxPly> pv_length_;
+};
+
+class Engine {
+ public:
+  using Callback = std::function<void(const SearchInfo&)>;
+
+  Engine(std::shared_ptr<const Evaluator> evaluator, size_t tt_megabytes = 64,
+         int threads = 1);
+
+  // Runs iterative deepening until the limits are reached or Stop() is
+  // called. `on_iteration` is called from the calling thread after every
+  // depth completed by the main thread; node counts include all threads.
+  SearchInfo Search(const Position& pos, const SearchLimits& limits,
+                    const Callback& on_iteration = {});
+
+  // Can be called from any thread.
+  void Stop() { stop_ = true; }
+
+  void NewGame();
+
+  // Endgame tables to probe during the search, null to stop probing.
+  void SetTablebase(std::shared_ptr<const Tablebase> tablebase) {
+    tablebase_ = std::move(tablebase);
+  }
+
+  // Positions with a book move (see OpeningBook::BestMove) are answered
+  // with it without searching (depth 0). Null turns the book off.
+  void SetBook(std::shared_ptr<const OpeningBook> book,
+               uint32_t min_games = OpeningBook::kMinGames) {
+    book_ = std::move(book);
+    book_min_games_ = min_games;
+  }
+
+  void SetThreads(int threads);
+  int Threads() const { return static_cast<int>(searchers_.size()); }
+
+ private:
+  // Iterative deepening of one thread. Helpers (thread_idx > 0) start on
+  // alternating depths so that threads spread over the next iterations.
+  SearchInfo IterativeDeepening(int thread_idx, const SearchLimits& limits,
+                                std::chrono::steady_clock::time_point start,
+                                const Callback& on_iteration);
+  uint64_t TotalNodes() const;
+
+  std::shared_ptr<const Evaluator> evaluator_;
+  std::shared_ptr<const Tablebase> tablebase_;
+  std::shared_ptr<const OpeningBook> book_;
+  uint32_t book_min_games_ = OpeningBook::kMinGames;
+  TranspositionTable tt_;
+  std::atomic<bool> stop_{false};
+  std::vector<std::unique_ptr<Searcher>> searchers_;
+};
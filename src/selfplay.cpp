@@ -0,0 +1,284 @@
+// Headless engine-vs-engine games for training and tuning data.
+//
+// Usage: zertz_selfplay [--games N] [--threads T] [--out PREFIX]
+//                       [--chunk-mb M] [--engine ab|mcts] [--nodes N]
+//                       [--playouts N] [--random-plies R] [--mb M] [--seed S]
+//                       [--tb FILE] [--book FILE] [--nnue FILE]
+//                       [--unique-openings 0|1]
+//
+// Every thread plays its own games one after another and appends them to
+// the shared chunked record files (see game_record.h). --games 0 runs until
+// interrupted: SIGINT or SIGTERM drops the games in progress, writes the
+// finished ones and exits; a second signal kills the process. With
+// --unique-openings 1 a random opening that is symmetric to one of the
+// first 2^20 distinct openings is drawn again.
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "game_record.h"
+#include "mcts.h"
+#include "movegen.h"
+#include "nnue.h"
+#include "search.h"
+#include "symmetry.h"
+
+namespace {
+
+// Games longer than this are adjudicated as draws.
+const int kMaxGamePlies = 1000;
+// Draws of a new opening before a repeated one is accepted.
+const int kOpeningRetries = 16;
+// Openings remembered for --unique-openings. Later openings are still
+// checked against them but not added, so endless runs stay bounded.
+const size_t kMaxOpenings = size_t{1} << 20;
+
+// Set by SIGINT and SIGTERM.
+std::atomic<bool> stop_requested{false};
+static_assert(std::atomic<bool>::is_always_lock_free);
+
+void OnStopSignal(int signal) {
+  stop_requested = true;
+  std::signal(signal, SIG_DFL);
+}
+
+struct Options {
+  uint64_t games = 1000;
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  std::string out = "selfplay";
+  size_t chunk_mb = 256;
+  bool mcts = false;
+  uint64_t nodes = 20000;
+  uint64_t playouts = 2000;
+  int random_plies = 4;
+  size_t mb = 16;
+  uint32_t seed = 1;
+  // Endgame tables for the alpha-beta engine (see tablebase.h).
+  std::string tablebase;
+  // Opening book for the alpha-beta engine (see book.h).
+  std::string book;
+  // Network weights for the alpha-beta engine (see nnue.h); the heuristic
+  // evaluation if empty.
+  std::string nnue;
+  bool unique_openings = false;
+};
+
+struct Stats {
+  std::atomic<uint64_t> started{0};
+  std::atomic<uint64_t> finished{0};
+  std::atomic<uint64_t> plies{0};
+  std::atomic<uint64_t> results[3] = {};
+};
+
+// Canonical keys (see symmetry.h) of the positions after the first
+// kMaxOpenings distinct openings.
+class OpeningSet {
+ public:
+  // Returns false if a symmetric opening was seen before.
+  bool Insert(uint64_t key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (seen_.size() >= kMaxOpenings) {
+      return seen_.count(key) == 0;
+    }
+    return seen_.insert(key).second;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::unordered_set<uint64_t> seen_;
+};
+
+// Plays the random first moves of the game into `pos` and `record`.
+void PlayOpening(const Options& options, OpeningSet& openings, std::mt19937& rng,
+                 MoveList& moves, Position& pos, GameRecord& record) {
+  for (int attempt = 0;; ++attempt) {
+    pos = Position(record.variant);
+    record.moves.clear();
+    for (int ply = 0; ply < options.random_plies; ++ply) {
+      GenerateMoves(pos, moves);
+      if (moves.Empty()) {
+        break;
+      }
+      Move move = moves[rng() % moves.Size()];
+      pos.MakeMove(move);
+      record.moves.push_back(move);
+    }
+    if (!options.unique_openings || attempt == kOpeningRetries ||
+        openings.Insert(CanonicalHash(pos))) {
+      return;
+    }
+  }
+}
+
+void Worker(const Options& options, std::shared_ptr<const Evaluator> evaluator,
+            std::shared_ptr<const Tablebase> tablebase, std::shared_ptr<const OpeningBook> book,
+            OpeningSet& openings, GameRecordWriter& writer, Stats& stats) {
+  std::unique_ptr<Engine> engine;
+  std::unique_ptr<Mcts> mcts;
+  if (options.mcts) {
+    mcts = std::make_unique<Mcts>(options.mb, 1);
+  } else {
+    engine = std::make_unique<Engine>(std::move(evaluator), options.mb, 1);
+    engine->SetTablebase(std::move(tablebase));
+    engine->SetBook(std::move(book));
+  }
+
+  SearchLimits search_limits;
+  search_limits.nodes = options.nodes;
+  MctsLimits mcts_limits;
+  mcts_limits.playouts = options.playouts;
+
+  MoveList moves;
+  GameRecord record;
+  record.moves.reserve(kMaxGamePlies);
+  while (!stop_requested) {
+    uint64_t game_idx = stats.started.fetch_add(1);
+    if (options.games && game_idx >= options.games) {
+      return;
+    }
+    record.seed = options.seed + static_cast<uint32_t>(game_idx);
+    std::mt19937 rng(record.seed);
+    if (engine) {
+      engine->NewGame();
+    }
+
+    Position pos(record.variant);
+    PlayOpening(options, openings, rng, moves, pos, record);
+    record.result = GameRecord::Result::kDraw;
+    for (int ply = static_cast<int>(record.moves.size());
+         ply < kMaxGamePlies && !stop_requested; ++ply) {
+      GenerateMoves(pos, moves);
+      if (moves.Empty()) {
+        auto winner = pos.Winner();
+        // Without legal moves the side to move loses.
+        PlayerId w = winner ? *winner : Opponent(pos.to_move);
+        record.result = w == PlayerId::kPlayer1 ? GameRecord::Result::kPlayer1
+                                                : GameRecord::Result::kPlayer2;
+        break;
+      }
+      Move move;
+      if (mcts) {
+        move = mcts->Search(pos, mcts_limits).best_move;
+      } else {
+        move = engine->Search(pos, search_limits).BestMove();
+      }
+      // A search stopped before its first iteration returns no move; a
+      // random legal one keeps the game going.
+      if (move == Move::None()) {
+        move = moves[rng() % moves.Size()];
+      }
+      pos.MakeMove(move);
+      record.moves.push_back(move);
+    }
+
+    if (stop_requested) {
+      return;
+    }
+    writer.Append(record);
+    stats.plies += record.moves.size();
+    ++stats.results[static_cast<int>(record.result)];
+    ++stats.finished;
+  }
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    const char* value = argv[i + 1];
+    if (key == "--games") options.games = std::strtoull(value, nullptr, 10);
+    else if (key == "--threads") options.threads = std::max(1, std::atoi(value));
+    else if (key == "--out") options.out = value;
+    else if (key == "--chunk-mb") options.chunk_mb = std::strtoull(value, nullptr, 10);
+    else if (key == "--engine" && std::strcmp(value, "ab") == 0) options.mcts = false;
+    else if (key == "--engine" && std::strcmp(value, "mcts") == 0) options.mcts = true;
+    else if (key == "--nodes") options.nodes = std::strtoull(value, nullptr, 10);
+    else if (key == "--playouts") options.playouts = std::strtoull(value, nullptr, 10);
+    else if (key == "--random-plies") options.random_plies = std::atoi(value);
+    else if (key == "--mb") options.mb = std::strtoull(value, nullptr, 10);
+    else if (key == "--seed") options.seed = std::strtoul(value, nullptr, 10);
+    else if (key == "--tb") options.tablebase = value;
+    else if (key == "--book") options.book = value;
+    else if (key == "--nnue") options.nnue = value;
+    else if (key == "--unique-openings") options.unique_openings = std::atoi(value) != 0;
+    else return false;
+  }
+  return argc % 2 == 1;
+}
+
+void Report(const Stats& stats, double seconds, uint64_t bytes) {
+  uint64_t games = stats.finished;
+  std::cout << games << " games, " << games / std::max(seconds, 1e-9) << " games/s, "
+            << (games ? static_cast<double>(stats.plies) / games : 0.0) << " plies/game, "
+            << "results " << stats.results[0] << "/" << stats.results[1] << "/"
+            << stats.results[2] << ", " << bytes << " bytes" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, options)) {
+    std::cerr << "Usage: " << argv[0] << " [--games N] [--threads T] [--out PREFIX]"
+              << " [--chunk-mb M] [--engine ab|mcts] [--nodes N] [--playouts N]"
+              << " [--random-plies R] [--mb M] [--seed S] [--tb FILE]"
+              << " [--book FILE] [--nnue FILE] [--unique-openings 0|1]\n";
+    return 1;
+  }
+
+  std::shared_ptr<const Evaluator> evaluator = std::make_shared<HeuristicEvaluator>();
+  if (!options.nnue.empty()) {
+    evaluator = std::make_shared<NnueEvaluator>(NnueWeights::Load(options.nnue));
+  }
+  // One mapping of each file shared by all threads.
+  std::shared_ptr<const Tablebase> tablebase;
+  if (!options.tablebase.empty()) {
+    tablebase = std::make_shared<Tablebase>(options.tablebase);
+  }
+  std::shared_ptr<const OpeningBook> book;
+  if (!options.book.empty()) {
+    book = std::make_shared<OpeningBook>(options.book);
+  }
+
+  std::signal(SIGINT, OnStopSignal);
+  std::signal(SIGTERM, OnStopSignal);
+  GameRecordWriter writer(options.out, options.chunk_mb * 1024 * 1024);
+  OpeningSet openings;
+  Stats stats;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int i = 0; i < options.threads; ++i) {
+    workers.emplace_back(Worker, std::cref(options), evaluator, tablebase, book,
+                         std::ref(openings), std::ref(writer), std::ref(stats));
+  }
+
+  std::atomic<bool> done{false};
+  std::thread reporter([&] {
+    while (!done) {
+      for (int i = 0; i < 100 && !done; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      }
+      double seconds = std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start).count();
+      Report(stats, seconds, writer.BytesWritten());
+    }
+  });
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  writer.Flush();
+  done = true;
+  reporter.join();
+  return 0;
+}
@@ -0,0 +1,193 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <tuple>
+
+#include "bitboard.h"
+#include "position.h"
+
+// Symmetries of the hex lattice and of the boards. The lattice has 6
+// rotations times 2 reflections; the 37- and 61-ring boards keep all 12 of
+// them and the 48-ring board (with sides of alternating length) keeps 6.
+// Symmetric positions have the same game value, so tables keyed by the
+// canonical form of a position store each of them once.
+
+constexpr int kNumLatticeSymmetries = 12;
+
+// Symmetry `sym` of the lattice around the origin: a reflection across
+// q = r for sym >= 6, followed by sym % 6 rotations by 60 degrees.
+constexpr QR TransformQR(QR qr, int sym) {
+  if (sym >= 6) {
+    qr = QR{qr.r, qr.q};
+  }
+  for (int i = 0; i < sym % 6; ++i) {
+    qr = QR{-qr.r, qr.q + qr.r};
+  }
+  return qr;
+}
+
+// The symmetries of one board as cell permutations. Masks are permuted a
+// byte at a time through lookup tables, 8 loads per mask.
+class BoardSymmetries {
+ public:
+  static const BoardSymmetries& Get(BoardVariant variant) {
+    static const BoardSymmetries kRings37(HexGeometry::Get(BoardVariant::kRings37));
+    static const BoardSymmetries kRings48(HexGeometry::Get(BoardVariant::kRings48));
+    static const BoardSymmetries kRings61(HexGeometry::Get(BoardVariant::kRings61));
+    switch (variant) {
+      case BoardVariant::kRings37:
+        return kRings37;
+      case BoardVariant::kRings48:
+        return kRings48;
+      case BoardVariant::kRings61:
+        return kRings61;
+    }
+    return kRings37;
+  }
+
+  // Symmetry 0 is the identity.
+  int Count() const { return count_; }
+
+  int Cell(int sym, int cell) const { return cells_[sym][cell]; }
+  int Direction(int sym, int direction) const { return directions_[sym][direction]; }
+  int Inverse(int sym) const { return inverse_[sym]; }
+
+  Mask Apply(int sym, Mask mask) const {
+    const auto& bytes = bytes_[sym];
+    Mask result = 0;
+    for (int i = 0; i < 8; ++i) {
+      result |= bytes[i][(mask >> (8 * i)) & 0xFF];
+    }
+    return result;
+  }
+
+  Move Apply(int sym, Move move) const {
+    if (move.IsCapture()) {
+      return Move::Capture(Cell(sym, move.From()), Direction(sym, move.Direction()));
+    }
+    int ring = move.RemovedRing();
+    return Move::Placement(move.Color(), Cell(sym, move.Cell()),
+                           ring == Move::kNoRing ? ring : Cell(sym, ring));
+  }
+
+ private:
+  explicit BoardSymmetries(const HexGeometry& geometry) {
+    int n = geometry.num_cells;
+    QR sum{0, 0};
+    for (int cell = 0; cell < n; ++cell) {
+      sum.q += geometry.cells[cell].q;
+      sum.r += geometry.cells[cell].r;
+    }
+    for (int sym = 0; sym < kNumLatticeSymmetries; ++sym) {
+      // The board maps onto itself iff the image of its cell set is a
+      // translation of it; the translation moves the centroid back.
+      QR image_sum{0, 0};
+      for (int cell = 0; cell < n; ++cell) {
+        QR image = TransformQR(geometry.cells[cell], sym);
+        image_sum.q += image.q;
+        image_sum.r += image.r;
+      }
+      if ((sum.q - image_sum.q) % n != 0 || (sum.r - image_sum.r) % n != 0) {
+        continue;
+      }
+      QR shift{(sum.q - image_sum.q) / n, (sum.r - image_sum.r) / n};
+      auto& cells = cells_[count_];
+      bool on_board = true;
+      for (int cell = 0; cell < n && on_board; ++cell) {
+        QR image = TransformQR(geometry.cells[cell], sym);
+        cells[cell] = geometry.IndexOf(QR{image.q + shift.q, image.r + shift.r});
+        on_board = cells[cell] != kNoCell;
+      }
+      if (!on_board) {
+        continue;
+      }
+      for (int d = 0; d < kNumDirections; ++d) {
+        QR image = TransformQR(kDirections[d], sym);
+        for (int e = 0; e < kNumDirections; ++e) {
+          if (kDirections[e] == image) {
+            directions_[count_][d] = e;
+          }
+        }
+      }
+      for (int i = 0; i < 8; ++i) {
+        for (int byte = 0; byte < 256; ++byte) {
+          Mask mask = 0;
+          for (int bit = 0; bit < 8; ++bit) {
+            int cell = 8 * i + bit;
+            if ((byte >> bit & 1) && cell < n) {
+              mask |= Bit(cells[cell]);
+            }
+          }
+          bytes_[count_][i][byte] = mask;
+        }
+      }
+      ++count_;
+    }
+    for (int sym = 0; sym < count_; ++sym) {
+      for (int other = 0; other < count_; ++other) {
+        bool identity = true;
+        for (int cell = 0; cell < n; ++cell) {
+          identity &= cells_[other][cells_[sym][cell]] == cell;
+        }
+        if (identity) {
+          inverse_[sym] = other;
+        }
+      }
+    }
+  }
+
+  int count_ = 0;
+  std::array<std::array<int8_t, HexGeometry::kMaxCells>, kNumLatticeSymmetries> cells_{};
+  std::array<std::array<int8_t, kNumDirections>, kNumLatticeSymmetries> directions_{};
+  std::array<int8_t, kNumLatticeSymmetries> inverse_{};
+  std::array<std::array<std::array<Mask, 256>, 8>, kNumLatticeSymmetries> bytes_{};
+};
+
+// The position under the symmetry of its board. Ball counts and the side
+// to move do not change.
+inline Position Transform(const Position& pos, int sym) {
+  const auto& symmetries = BoardSymmetries::Get(pos.board.Variant());
+  Position result = pos;
+  result.board.rings = symmetries.Apply(sym, pos.board.rings);
+  for (int c = 0; c < kNumColors; ++c) {
+    result.board.balls[c] = symmetries.Apply(sym, pos.board.balls[c]);
+  }
+  if (pos.chain_cell != kNoCell) {
+    result.chain_cell = static_cast<int8_t>(symmetries.Cell(sym, pos.chain_cell));
+  }
+  result.hash = result.ComputeHash();
+  return result;
+}
+
+// The symmetry that maps the position to its canonical form: the one with
+// the smallest (rings, white, grey, black) masks, then the smallest chain
+// cell.
+inline int CanonicalSymmetry(const Position& pos) {
+  const auto& symmetries = BoardSymmetries::Get(pos.board.Variant());
+  auto Key = [&] (int sym) {
+    const auto& board = pos.board;
+    return std::make_tuple(
+        symmetries.Apply(sym, board.rings), symmetries.Apply(sym, board.balls[0]),
+        symmetries.Apply(sym, board.balls[1]), symmetries.Apply(sym, board.balls[2]),
+        pos.chain_cell == kNoCell ? kNoCell : symmetries.Cell(sym, pos.chain_cell));
+  };
+  int best = 0;
+  auto best_key = Key(0);
+  for (int sym = 1; sym < symmetries.Count(); ++sym) {
+    auto key = Key(sym);
+    if (key < best_key) {
+      best = sym;
+      best_key = key;
+    }
+  }
+  return best;
+}
+
+inline Position Canonical(const Position& pos) {
+  return Transform(pos, CanonicalSymmetry(pos));
+}
+
+// Zobrist key of the canonical form: equal for all symmetric positions.
+inline uint64_t CanonicalHash(const Position& pos) {
+  return Canonical(pos).hash;
+}
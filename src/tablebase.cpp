@@ -0,0 +1,443 @@
+#include "tablebase.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <stdexcept>
+#include <utility>
+
+#include "symmetry.h"
+
+namespace {
+
+constexpr char kMagic[4] = {'Z', 'T', 'B', '3'};
+
+struct Header {
+  char magic[4];
+  uint8_t max_rings;
+  uint8_t max_supply;
+  uint16_t reserved;
+  uint32_t boards;
+  uint32_t buckets;
+};
+
+static_assert(sizeof(Header) == 16);
+
+// Board keys: every group is a list of 9-bit cell codes, sorted, the first
+// one marked by kGroupStart. Codes are dq << 5 | dr << 2 | contents, where
+// (dq, dr) is the cell relative to the minimal q and r of the group and the
+// contents are 0 for a vacant ring and 1 + color for a ball. Of the 12
+// symmetric images of a group the one with the smallest codes is used.
+constexpr int kCodeBits = 9;
+constexpr uint64_t kGroupStart = 256;
+
+// (number of rings, packed codes)
+using Group = std::pair<int, uint64_t>;
+
+uint64_t Mix64(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+uint64_t PackGroup(const uint32_t* codes, int count) {
+  uint64_t packed = 0;
+  for (int i = count - 1; i >= 0; --i) {
+    packed = packed << kCodeBits | codes[i] | (i == 0 ? kGroupStart : 0);
+  }
+  return packed;
+}
+
+uint64_t CanonicalGroup(const QR* cells, const int* contents, int count) {
+  uint64_t best = ~uint64_t{0};
+  for (int sym = 0; sym < kNumLatticeSymmetries; ++sym) {
+    std::array<QR, TablebaseIndex::kMaxRings> images;
+    int min_q = 0;
+    int min_r = 0;
+    for (int i = 0; i < count; ++i) {
+      images[i] = TransformQR(cells[i], sym);
+      min_q = i == 0 ? images[i].q : std::min(min_q, images[i].q);
+      min_r = i == 0 ? images[i].r : std::min(min_r, images[i].r);
+    }
+    std::array<uint32_t, TablebaseIndex::kMaxRings> codes;
+    for (int i = 0; i < count; ++i) {
+      codes[i] = (images[i].q - min_q) << 5 | (images[i].r - min_r) << 2 | contents[i];
+    }
+    std::sort(codes.begin(), codes.begin() + count);
+    best = std::min(best, PackGroup(codes.data(), count));
+  }
+  return best;
+}
+
+uint64_t PackGroups(Group* groups, int count) {
+  std::sort(groups, groups + count);
+  uint64_t key = 0;
+  int shift = 0;
+  for (int i = 0; i < count; ++i) {
+    key |= groups[i].second << shift;
+    shift += kCodeBits * groups[i].first;
+  }
+  return key;
+}
+
+// Normalized shapes of all groups of `size` rings.
+std::vector<std::vector<QR>> Polyhexes(int size) {
+  std::set<std::vector<std::pair<int, int>>> shapes = {{{0, 0}}};
+  for (int n = 1; n < size; ++n) {
+    std::set<std::vector<std::pair<int, int>>> grown;
+    for (const auto& shape : shapes) {
+      for (auto [q, r] : shape) {
+        for (QR dir : kDirections) {
+          std::pair<int, int> cell{q + dir.q, r + dir.r};
+          if (std::find(shape.begin(), shape.end(), cell) != shape.end()) {
+            continue;
+          }
+          auto next = shape;
+          next.push_back(cell);
+          int min_q = next[0].first;
+          int min_r = next[0].second;
+          for (auto [cq, cr] : next) {
+            min_q = std::min(min_q, cq);
+            min_r = std::min(min_r, cr);
+          }
+          for (auto& [cq, cr] : next) {
+            cq -= min_q;
+            cr -= min_r;
+          }
+          std::sort(next.begin(), next.end());
+          grown.insert(std::move(next));
+        }
+      }
+    }
+    shapes = std::move(grown);
+  }
+  std::vector<std::vector<QR>> result;
+  for (const auto& shape : shapes) {
+    std::vector<QR> cells;
+    for (auto [q, r] : shape) {
+      cells.push_back(QR{q, r});
+    }
+    result.push_back(std::move(cells));
+  }
+  return result;
+}
+
+void CollectBoards(const std::vector<Group>& groups, size_t first, int rings_left,
+                   std::vector<Group>& chosen, std::vector<uint64_t>& keys) {
+  auto copy = chosen;
+  keys.push_back(PackGroups(copy.data(), static_cast<int>(copy.size())));
+  for (size_t i = first; i < groups.size(); ++i) {
+    if (groups[i].first > rings_left) {
+      break;
+    }
+    chosen.push_back(groups[i]);
+    CollectBoards(groups, i, rings_left - groups[i].first, chosen, keys);
+    chosen.pop_back();
+  }
+}
+
+// Dense ranks of the captured balls of one player that do not win, by
+// white * 30 + grey * 6 + black, and the captured balls of every rank.
+struct CapturedRankTable {
+  std::array<uint8_t, 4 * 5 * 6> rank{};
+  std::array<Position::Counts, TablebaseIndex::kCapturedConfigs> counts{};
+};
+
+const CapturedRankTable& CapturedRanks() {
+  static const CapturedRankTable table = [] {
+    CapturedRankTable table;
+    int next = 0;
+    for (uint8_t white = 0; white < 4; ++white) {
+      for (uint8_t grey = 0; grey < 5; ++grey) {
+        for (uint8_t black = 0; black < 6; ++black) {
+          Position::Counts counts = {white, grey, black};
+          if (!Position::HasWon(counts)) {
+            table.rank[white * 30 + grey * 6 + black] = next;
+            table.counts[next++] = counts;
+          }
+        }
+      }
+    }
+    assert(next == TablebaseIndex::kCapturedConfigs);
+    return table;
+  }();
+  return table;
+}
+
+}
+
+TablebaseIndex::TablebaseIndex(int max_rings, int max_supply)
+  : max_rings_(max_rings)
+  , max_supply_(max_supply)
+  , supply_rank_((max_supply + 1) * (max_supply + 1) * (max_supply + 1)) {
+  for (int s0 = 0; s0 <= max_supply; ++s0) {
+    for (int s1 = 0; s0 + s1 <= max_supply; ++s1) {
+      for (int s2 = 0; s0 + s1 + s2 <= max_supply; ++s2) {
+        supply_rank_[(s0 * (max_supply + 1) + s1) * (max_supply + 1) + s2] = supplies_.size();
+        supplies_.push_back({static_cast<uint8_t>(s0), static_cast<uint8_t>(s1),
+                             static_cast<uint8_t>(s2)});
+      }
+    }
+  }
+  assert(supplies_.size() <= UINT16_MAX);
+}
+
+bool TablebaseIndex::InDomain(const Position& pos) const {
+  return pos.chain_cell == kNoCell && PopCount(pos.board.rings) <= max_rings_ &&
+      pos.supply[0] + pos.supply[1] + pos.supply[2] <= max_supply_ && !pos.Winner();
+}
+
+uint64_t TablebaseIndex::CountsIndex(const Position& pos) const {
+  const auto& ranks = CapturedRanks();
+  int side = max_supply_ + 1;
+  uint64_t index = supply_rank_[(pos.supply[0] * side + pos.supply[1]) * side + pos.supply[2]];
+  for (const auto& captured : pos.captured) {
+    index = index * kCapturedConfigs + ranks.rank[captured[0] * 30 + captured[1] * 6 + captured[2]];
+  }
+  return index * 2 + Index(pos.to_move);
+}
+
+void TablebaseIndex::SetCounts(uint64_t index, Position& pos) const {
+  const auto& ranks = CapturedRanks();
+  pos.to_move = static_cast<PlayerId>(index % 2);
+  index /= 2;
+  for (int player = 1; player >= 0; --player) {
+    pos.captured[player] = ranks.counts[index % kCapturedConfigs];
+    index /= kCapturedConfigs;
+  }
+  pos.supply = supplies_[index];
+}
+
+uint64_t TablebaseIndex::BoardKey(const BitBoard& board) {
+  const HexGeometry& geometry = *board.geometry;
+  std::array<Group, kMaxRings> groups;
+  int num_groups = 0;
+  Mask left = board.rings;
+  while (left) {
+    assert(num_groups < kMaxRings);
+    Mask group = Bit(LowestBit(left));
+    Mask frontier = group;
+    while (frontier) {
+      Mask next = 0;
+      for (int cell : SetBits{frontier}) {
+        next |= geometry.neighbor_mask[cell];
+      }
+      frontier = next & board.rings & ~group;
+      group |= frontier;
+    }
+    left &= ~group;
+
+    std::array<QR, kMaxRings> cells;
+    std::array<int, kMaxRings> contents;
+    int count = 0;
+    for (int cell : SetBits{group}) {
+      auto color = board.ColorAt(cell);
+      cells[count] = geometry.cells[cell];
+      contents[count++] = color ? 1 + static_cast<int>(*color) : 0;
+    }
+    groups[num_groups++] = {count, CanonicalGroup(cells.data(), contents.data(), count)};
+  }
+  return PackGroups(groups.data(), num_groups);
+}
+
+bool TablebaseIndex::PlaceBoard(uint64_t key, BitBoard& board) {
+  const HexGeometry& geometry = *board.geometry;
+  board.rings = 0;
+  board.balls = {};
+  while (key) {
+    std::vector<uint32_t> codes = {static_cast<uint32_t>(key & (kGroupStart - 1))};
+    key >>= kCodeBits;
+    while (key && !(key & kGroupStart)) {
+      codes.push_back(static_cast<uint32_t>(key & (kGroupStart - 1)));
+      key >>= kCodeBits;
+    }
+
+    // First translation that keeps the group apart from the others.
+    bool placed = false;
+    for (int q0 = 0; q0 < geometry.grid && !placed; ++q0) {
+      for (int r0 = 0; r0 < geometry.grid && !placed; ++r0) {
+        Mask group = 0;
+        Mask around = 0;
+        for (uint32_t code : codes) {
+          int cell = geometry.IndexOf(QR{q0 + static_cast<int>(code >> 5),
+                                         r0 + static_cast<int>(code >> 2 & 7)});
+          if (cell == kNoCell) {
+            group = 0;
+            break;
+          }
+          group |= Bit(cell);
+          around |= geometry.neighbor_mask[cell];
+        }
+        if (!group || ((group | around) & board.rings)) {
+          continue;
+        }
+        for (uint32_t code : codes) {
+          int cell = geometry.IndexOf(QR{q0 + static_cast<int>(code >> 5),
+                                         r0 + static_cast<int>(code >> 2 & 7)});
+          board.rings |= Bit(cell);
+          if (code & 3) {
+            board.balls[(code & 3) - 1] |= Bit(cell);
+          }
+        }
+        placed = true;
+      }
+    }
+    if (!placed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<uint64_t> TablebaseIndex::AllBoards(int max_rings) {
+  assert(max_rings <= kMaxRings);
+  std::vector<Group> groups;
+  for (int size = 1; size <= max_rings; ++size) {
+    for (const auto& shape : Polyhexes(size)) {
+      std::array<int, kMaxRings> contents;
+      for (int coloring = 0; coloring < 1 << (2 * size); ++coloring) {
+        for (int i = 0; i < size; ++i) {
+          contents[i] = coloring >> (2 * i) & 3;
+        }
+        groups.emplace_back(size, CanonicalGroup(shape.data(), contents.data(), size));
+      }
+    }
+  }
+  // Symmetric shapes and colorings give the same group.
+  std::sort(groups.begin(), groups.end());
+  groups.erase(std::unique(groups.begin(), groups.end()), groups.end());
+
+  std::vector<uint64_t> keys;
+  std::vector<Group> chosen;
+  CollectBoards(groups, 0, max_rings, chosen, keys);
+  return keys;
+}
+
+std::vector<uint32_t> PerfectHash::Build(const std::vector<uint64_t>& keys) {
+  uint32_t size = static_cast<uint32_t>(keys.size());
+  uint32_t buckets = NumBuckets(size);
+  std::vector<std::vector<uint64_t>> bucket_keys(buckets);
+  for (uint64_t key : keys) {
+    bucket_keys[Mix64(key) % buckets].push_back(key);
+  }
+  // Large buckets first, while most slots are still free.
+  std::vector<uint32_t> order(buckets);
+  for (uint32_t b = 0; b < buckets; ++b) {
+    order[b] = b;
+  }
+  std::stable_sort(order.begin(), order.end(), [&] (uint32_t left, uint32_t right) {
+    return bucket_keys[left].size() > bucket_keys[right].size();
+  });
+
+  std::vector<uint32_t> displacement(buckets, 0);
+  std::vector<bool> taken(size, false);
+  std::vector<uint32_t> slots;
+  for (uint32_t b : order) {
+    const auto& bucket = bucket_keys[b];
+    if (bucket.empty()) {
+      break;
+    }
+    for (uint32_t d = 0;; ++d) {
+      displacement[b] = d;
+      slots.clear();
+      bool fits = true;
+      for (uint64_t key : bucket) {
+        uint32_t slot = Slot(key, displacement.data(), buckets, size);
+        if (taken[slot] || std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+          fits = false;
+          break;
+        }
+        slots.push_back(slot);
+      }
+      if (fits) {
+        break;
+      }
+    }
+    for (uint32_t slot : slots) {
+      taken[slot] = true;
+    }
+  }
+  return displacement;
+}
+
+uint32_t PerfectHash::Slot(uint64_t key, const uint32_t* displacement, uint32_t buckets,
+                           uint32_t size) {
+  uint32_t d = displacement[Mix64(key) % buckets];
+  return static_cast<uint32_t>(Mix64(key + 0xD6E8FEB86659FD93ULL * (d + 1)) % size);
+}
+
+Tablebase::Tablebase(const std::string& path) : file_(path) {
+  Header header;
+  if (file_.Size() < sizeof(header)) {
+    throw std::runtime_error("Bad tablebase " + path);
+  }
+  std::memcpy(&header, file_.Data(), sizeof(header));
+  boards_ = header.boards;
+  buckets_ = header.buckets;
+  // Slot divides by both counts.
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || boards_ == 0 ||
+      buckets_ != PerfectHash::NumBuckets(boards_) ||
+      header.max_rings > TablebaseIndex::kMaxRings ||
+      header.max_supply > TablebaseIndex::kMaxSupply) {
+    throw std::runtime_error("Bad tablebase " + path);
+  }
+  index_ = TablebaseIndex(header.max_rings, header.max_supply);
+  const uint8_t* bytes = file_.Data();
+  size_t offset = sizeof(Header);
+  displacement_ = reinterpret_cast<const uint32_t*>(bytes + offset);
+  offset += (buckets_ * sizeof(uint32_t) + 7) / 8 * 8;
+  keys_ = reinterpret_cast<const uint64_t*>(bytes + offset);
+  offset += boards_ * sizeof(uint64_t);
+  entries_ = bytes + offset;
+  if (offset + boards_ * index_.EntriesPerBoard() != file_.Size()) {
+    throw std::runtime_error("Bad tablebase " + path);
+  }
+}
+
+std::optional<TablebaseEntry> Tablebase::Probe(const Position& pos) const {
+  if (!index_.InDomain(pos)) {
+    return std::nullopt;
+  }
+  uint64_t key = TablebaseIndex::BoardKey(pos.board);
+  uint32_t slot = PerfectHash::Slot(key, displacement_, buckets_, boards_);
+  if (keys_[slot] != key) {
+    return std::nullopt;
+  }
+  auto entry = TablebaseEntry::FromByte(
+      entries_[slot * index_.EntriesPerBoard() + index_.CountsIndex(pos)]);
+  if (entry.result == TablebaseEntry::Result::kInvalid) {
+    return std::nullopt;
+  }
+  return entry;
+}
+
+void WriteTablebase(const std::string& path, const TablebaseIndex& index,
+                    const std::vector<uint64_t>& keys, const std::vector<uint32_t>& displacement,
+                    const uint8_t* entries) {
+  size_t size = keys.size() * index.EntriesPerBoard();
+  Header header{.max_rings = static_cast<uint8_t>(index.MaxRings()),
+                .max_supply = static_cast<uint8_t>(index.MaxSupply()),
+                .reserved = 0,
+                .boards = static_cast<uint32_t>(keys.size()),
+                .buckets = static_cast<uint32_t>(displacement.size())};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+
+  FILE* file = std::fopen(path.c_str(), "wb");
+  if (!file) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  size_t padding = (displacement.size() * sizeof(uint32_t)) % 8 ? 4 : 0;
+  const uint32_t zero = 0;
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+      std::fwrite(displacement.data(), sizeof(uint32_t), displacement.size(), file) ==
+          displacement.size() &&
+      std::fwrite(&zero, 1, padding, file) == padding &&
+      std::fwrite(keys.data(), sizeof(uint64_t), keys.size(), file) == keys.size() &&
+      std::fwrite(entries, 1, size, file) == size;
+  ok = std::fclose(file) == 0 && ok;
+  if (!ok) {
+    throw std::runtime_error("Cannot write " + path);
+  }
+}
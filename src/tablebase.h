@@ -0,0 +1,151 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "evaluation.h"
+#include "mapped_file.h"
+#include "position.h"
+
+// Endgame tablebases for positions with few rings and a small supply.
+//
+// The rules only depend on which rings touch which, so a board is keyed by
+// its groups of connected rings (with their balls), each normalized by
+// translation and lattice symmetry (see symmetry.h) and sorted. The key
+// does not depend on the board variant.
+// A position belongs to a table if it has at most max rings rings, at most
+// max supply balls in the supply, no winner, and is not in the middle of a
+// capture chain.
+//
+// Entries are found by a perfect hash: a minimal perfect hash of the board
+// key selects a block, and the block is indexed densely by the supply, the
+// captured balls and the side to move.
+//
+// File layout (little-endian):
+//   "ZTB3", u8 max rings, u8 max supply, u16 0, u32 boards, u32 buckets,
+//   u32 displacement[buckets] padded to 8 bytes, u64 board key[boards] in
+//   slot order, u8 entry[boards * EntriesPerBoard()].
+
+struct TablebaseEntry {
+  enum class Result : uint8_t { kDraw, kWin, kLoss, kInvalid };
+
+  Result result = Result::kDraw;
+  // Turns to the end of the game for the side to move, a capture chain
+  // being one turn. Zero for draws.
+  int distance = 0;
+
+  static TablebaseEntry FromByte(uint8_t byte) {
+    return TablebaseEntry{.result = static_cast<Result>(byte & 3), .distance = byte >> 2};
+  }
+
+  uint8_t ToByte() const { return static_cast<uint8_t>(distance << 2 | static_cast<int>(result)); }
+};
+
+// Longest distance an entry can hold.
+constexpr int kMaxTablebaseDistance = 63;
+
+// Search score of an entry: at the top of the evaluation range, so that
+// wins found by the search itself still come first.
+inline int TablebaseScore(const TablebaseEntry& entry) {
+  switch (entry.result) {
+    case TablebaseEntry::Result::kWin:
+      return kMaxEval - entry.distance;
+    case TablebaseEntry::Result::kLoss:
+      return -(kMaxEval - entry.distance);
+    default:
+      return 0;
+  }
+}
+
+// Which positions a table covers and where they go inside a board block.
+class TablebaseIndex {
+ public:
+  // Board keys take 9 bits per ring.
+  static constexpr int kMaxRings = 7;
+  // Balls of the largest supply, that of the 61-ring board.
+  static constexpr int kMaxSupply = 10 + 12 + 14;
+
+  TablebaseIndex(int max_rings, int max_supply);
+
+  int MaxRings() const { return max_rings_; }
+  int MaxSupply() const { return max_supply_; }
+
+  // Captured balls of one player that do not win: below every target on
+  // its own and not three of each.
+  static constexpr int kCapturedConfigs = 4 * 5 * 6 - 1 * 2 * 3;
+
+  uint64_t EntriesPerBoard() const {
+    return supplies_.size() * kCapturedConfigs * kCapturedConfigs * 2;
+  }
+
+  bool InDomain(const Position& pos) const;
+
+  // Index of the supply, captured balls and side to move inside a block.
+  uint64_t CountsIndex(const Position& pos) const;
+
+  // Sets the supply, captured balls and side to move of the index. Every
+  // index is a position of the domain, apart from its board.
+  void SetCounts(uint64_t index, Position& pos) const;
+
+  static uint64_t BoardKey(const BitBoard& board);
+
+  // Puts the groups of the key on a board without rings, apart from each
+  // other. Returns false if they do not fit.
+  static bool PlaceBoard(uint64_t key, BitBoard& board);
+
+  // Keys of all boards with at most `max_rings` rings.
+  static std::vector<uint64_t> AllBoards(int max_rings);
+
+ private:
+  int max_rings_;
+  int max_supply_;
+  // Supplies of at most max supply balls in rank order, and the rank of
+  // every supply at (white * side + grey) * side + black, side being max
+  // supply + 1.
+  std::vector<Position::Counts> supplies_;
+  std::vector<uint16_t> supply_rank_;
+};
+
+// Minimal perfect hash of a fixed set of keys by hash and displace: every
+// key falls into a bucket, and each bucket has a displacement that sends
+// all its keys to distinct free slots.
+class PerfectHash {
+ public:
+  static uint32_t NumBuckets(uint32_t size) { return size / 4 + 1; }
+
+  // Displacements of all buckets.
+  static std::vector<uint32_t> Build(const std::vector<uint64_t>& keys);
+
+  static uint32_t Slot(uint64_t key, const uint32_t* displacement, uint32_t buckets,
+                       uint32_t size);
+};
+
+// A tablebase file mapped into memory (see mapped_file.h), so probes only
+// read the pages they touch.
+class Tablebase {
+ public:
+  // Throws std::runtime_error if the file cannot be mapped or is not a
+  // table.
+  explicit Tablebase(const std::string& path);
+
+  const TablebaseIndex& Index() const { return index_; }
+
+  // Result for the side to move, nullopt if the position is not covered.
+  std::optional<TablebaseEntry> Probe(const Position& pos) const;
+
+ private:
+  MappedFile file_;
+  TablebaseIndex index_{0, 0};
+  uint32_t boards_ = 0;
+  uint32_t buckets_ = 0;
+  const uint32_t* displacement_ = nullptr;
+  const uint64_t* keys_ = nullptr;
+  const uint8_t* entries_ = nullptr;
+};
+
+// Writes a table; `keys` are the board keys in slot order and `entries`
+// the blocks in the same order, keys.size() * index.EntriesPerBoard() bytes.
+void WriteTablebase(const std::string& path, const TablebaseIndex& index,
+                    const std::vector<uint64_t>& keys, const std::vector<uint32_t>& displacement,
+                    const uint8_t* entries);
@@ -0,0 +1,286 @@
+// Endgame tablebase generator.
+//
+// Usage: zertz_tbgen <max rings> <max supply> <output file> [--threads T]
+//
+// Enumerates every board with at most <max rings> rings and every ball
+// count with at most <max supply> balls in the supply (see tablebase.h) and
+// solves them by retrograde analysis: pass 0 finds the positions without
+// legal moves, pass n the positions won or lost in n turns, where a capture
+// chain is a single turn. Positions still open when a pass finds nothing
+// new are draws. Fails without writing the table if positions are still
+// resolved at the largest distance an entry holds.
+//
+// The table is built in memory and takes one byte per entry: boards times
+// 2 * 114 * 114 captured balls and sides to move times the supplies of at
+// most <max supply> balls. 4 rings and 3 balls are 1875 boards and 975 MB;
+// 5 rings and no supply 25471 boards and 660 MB; 6 rings and no supply
+// 408315 boards and 10.6 GB. Board keys allow up to 7 rings.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "movegen.h"
+#include "tablebase.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Result = TablebaseEntry::Result;
+
+// A turn that can be played on a board, whatever the ball counts are:
+// the board after it, and the ball it takes from the reserve (-1 for
+// capture chains) and the balls it gains.
+struct Turn {
+  uint32_t slot;
+  int color;
+  Position::Counts gained;
+};
+
+class Generator {
+ public:
+  Generator(int max_rings, int max_supply, int threads)
+    : index_(max_rings, max_supply), threads_(threads) {}
+
+  // Returns false if the table cannot be solved within the distances an
+  // entry holds.
+  bool Run(const std::string& path) {
+    auto start = Clock::now();
+    auto boards = TablebaseIndex::AllBoards(index_.MaxRings());
+    displacement_ = PerfectHash::Build(boards);
+    keys_.resize(boards.size());
+    for (uint64_t key : boards) {
+      keys_[Slot(key)] = key;
+    }
+    entries_per_board_ = index_.EntriesPerBoard();
+    std::cout << boards.size() << " boards, " << boards.size() * entries_per_board_
+              << " entries\n";
+
+    turns_.resize(keys_.size());
+    placed_.resize(keys_.size());
+    ForEachSlot([&] (uint32_t slot) { FindTurns(slot); });
+    values_ = std::vector<std::atomic<uint8_t>>(keys_.size() * entries_per_board_);
+    ForEachSlot([&] (uint32_t slot) { MarkInvalid(slot); });
+
+    bool complete = false;
+    for (int pass = 0; pass <= kMaxTablebaseDistance && !complete; ++pass) {
+      std::atomic<uint64_t> resolved{0};
+      ForEachSlot([&] (uint32_t slot) { resolved += Solve(slot, pass); });
+      double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+      std::cout << "pass " << pass << ": " << resolved << " resolved, " << seconds << " s\n";
+      complete = pass > 0 && resolved == 0;
+    }
+    // Positions still open may be decided in more turns than an entry
+    // holds; writing them as draws would be wrong.
+    if (!complete) {
+      std::cerr << "Positions are still resolved after " << kMaxTablebaseDistance
+                << " turns; the table is not written\n";
+      return false;
+    }
+
+    std::array<uint64_t, 4> totals{};
+    for (const auto& value : values_) {
+      ++totals[value.load(std::memory_order_relaxed) & 3];
+    }
+    std::cout << "wins " << totals[static_cast<int>(Result::kWin)]
+              << ", losses " << totals[static_cast<int>(Result::kLoss)]
+              << ", draws " << totals[static_cast<int>(Result::kDraw)]
+              << ", invalid " << totals[static_cast<int>(Result::kInvalid)] << "\n";
+    // The workers are joined, so the bytes are written as they are.
+    WriteTablebase(path, index_, keys_, displacement_,
+                   reinterpret_cast<const uint8_t*>(values_.data()));
+    return true;
+  }
+
+ private:
+  uint32_t Slot(uint64_t key) const {
+    return PerfectHash::Slot(key, displacement_.data(), static_cast<uint32_t>(displacement_.size()),
+                             static_cast<uint32_t>(keys_.size()));
+  }
+
+  template <typename F>
+  void ForEachSlot(F&& f) {
+    std::atomic<uint32_t> next{0};
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads_; ++i) {
+      workers.emplace_back([&] {
+        for (uint32_t slot = next++; slot < keys_.size(); slot = next++) {
+          f(slot);
+        }
+      });
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+
+  // Lays the board out on the largest board and lists its turns. The
+  // supply holds one ball of every color so that all placements show up;
+  // whose reserve the ball comes from is decided per entry.
+  void FindTurns(uint32_t slot) {
+    Position pos(BoardVariant::kRings61);
+    if (!TablebaseIndex::PlaceBoard(keys_[slot], pos.board)) {
+      return;
+    }
+    placed_[slot] = true;
+    pos.supply = {1, 1, 1};
+    pos.hash = pos.ComputeHash();
+
+    MoveList moves;
+    GenerateCaptures(pos, moves);
+    if (!moves.Empty()) {
+      FindChains(pos, moves, turns_[slot]);
+      return;
+    }
+    GeneratePlacements(pos, moves);
+    for (Move move : moves) {
+      auto undo = pos.MakeMove(move);
+      turns_[slot].push_back(Turn{.slot = Slot(TablebaseIndex::BoardKey(pos.board)),
+                                  .color = Index(move.Color()),
+                                  .gained = pos.captured[0]});
+      pos.UnmakeMove(move, undo);
+    }
+  }
+
+  // Every way to play the capture chain to its end. Chains are not cut
+  // short by a win here: gains only grow along a chain, so whether some
+  // prefix wins for given counts is decided by the full chain.
+  void FindChains(Position& pos, const MoveList& moves, std::vector<Turn>& turns) {
+    for (Move move : moves) {
+      auto undo = pos.MakeMove(move);
+      if (pos.chain_cell != kNoCell) {
+        MoveList next;
+        GenerateCaptures(pos, next);
+        FindChains(pos, next, turns);
+      } else {
+        turns.push_back(Turn{.slot = Slot(TablebaseIndex::BoardKey(pos.board)),
+                             .color = -1,
+                             .gained = pos.captured[0]});
+      }
+      pos.UnmakeMove(move, undo);
+    }
+  }
+
+  // Every ball count is valid, so only boards no position reaches are
+  // invalid.
+  void MarkInvalid(uint32_t slot) {
+    if (placed_[slot]) {
+      return;
+    }
+    auto* values = &values_[slot * entries_per_board_];
+    for (uint64_t i = 0; i < entries_per_board_; ++i) {
+      values[i].store(TablebaseEntry{.result = Result::kInvalid}.ToByte(),
+                      std::memory_order_relaxed);
+    }
+  }
+
+  // Resolves the entries of the board that are decided in `pass` turns.
+  // Entries resolved in this pass have distance `pass` and are not used
+  // until the next one. Returns the number of resolved entries.
+  uint64_t Solve(uint32_t slot, int pass) {
+    const auto& turns = turns_[slot];
+    auto* values = &values_[slot * entries_per_board_];
+    uint64_t resolved = 0;
+    Position pos;
+    for (uint64_t i = 0; i < entries_per_board_; ++i) {
+      if (values[i].load(std::memory_order_relaxed) != 0) {
+        continue;
+      }
+      index_.SetCounts(i, pos);
+      int me = Index(pos.to_move);
+      bool any = false;
+      bool win = false;
+      bool all_lost = true;
+      for (const Turn& turn : turns) {
+        Position next = pos;
+        if (turn.color >= 0) {
+          auto& reserve = next.SupplyEmpty() ? next.captured[me] : next.supply;
+          if (reserve[turn.color] == 0) {
+            continue;
+          }
+          --reserve[turn.color];
+        }
+        any = true;
+        for (int c = 0; c < kNumColors; ++c) {
+          next.captured[me][c] += turn.gained[c];
+        }
+        if (Position::HasWon(next.captured[me])) {
+          win = true;
+          break;
+        }
+        next.to_move = Opponent(pos.to_move);
+        auto entry = TablebaseEntry::FromByte(
+            values_[turn.slot * entries_per_board_ + index_.CountsIndex(next)].load(
+                std::memory_order_relaxed));
+        bool known = entry.result != Result::kDraw && entry.result != Result::kInvalid &&
+            entry.distance < pass;
+        if (known && entry.result == Result::kLoss) {
+          win = true;
+          break;
+        }
+        if (!known) {
+          all_lost = false;
+        }
+      }
+
+      TablebaseEntry entry{.distance = pass};
+      if (pass == 0) {
+        if (any) {
+          continue;
+        }
+        entry.result = Result::kLoss;
+      } else if (win) {
+        entry.result = Result::kWin;
+      } else if (any && all_lost) {
+        entry.result = Result::kLoss;
+      } else {
+        continue;
+      }
+      values[i].store(entry.ToByte(), std::memory_order_relaxed);
+      ++resolved;
+    }
+    return resolved;
+  }
+
+  TablebaseIndex index_;
+  int threads_;
+  uint64_t entries_per_board_ = 0;
+  std::vector<uint32_t> displacement_;
+  std::vector<uint64_t> keys_;
+  std::vector<std::vector<Turn>> turns_;
+  std::vector<char> placed_;
+  // Entry bytes; 0 (a draw at distance 0) marks open positions.
+  // Written to the table in place.
+  std::vector<std::atomic<uint8_t>> values_;
+  static_assert(sizeof(std::atomic<uint8_t>) == 1 && std::atomic<uint8_t>::is_always_lock_free);
+};
+
+}
+
+int main(int argc, char** argv) {
+  std::vector<std::string> args;
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      threads = std::max(1, std::atoi(argv[++i]));
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+  int max_rings = args.size() == 3 ? std::atoi(args[0].c_str()) : 0;
+  int max_supply = args.size() == 3 ? std::atoi(args[1].c_str()) : -1;
+  if (max_rings <= 0 || max_rings > TablebaseIndex::kMaxRings || max_supply < 0 ||
+      max_supply > TablebaseIndex::kMaxSupply) {
+    std::cerr << "Usage: " << argv[0] << " <max rings (1-" << TablebaseIndex::kMaxRings
+              << ")> <max supply (0-" << TablebaseIndex::kMaxSupply
+              << ")> <output file> [--threads T]\n";
+    return 1;
+  }
+  return Generator(max_rings, max_supply, threads).Run(args[2]) ? 0 : 1;
+}
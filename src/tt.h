@@ -0,0 +1,122 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+#include "evaluation.h"
+#include "position.h"
+
+// Transposition table shared by search threads without locks. An entry is
+// two 64-bit words: the data and the key xor-ed with the data. A torn write
+// from two threads fails the key check on probe instead of returning a mix
+// of two entries.
+class TranspositionTable {
+ public:
+  enum class Bound : uint8_t { kNone, kUpper, kLower, kExact };
+
+  struct Entry {
+    Move move = Move::None();
+    int score = 0;
+    int depth = 0;
+    Bound bound = Bound::kNone;
+  };
+
+  explicit TranspositionTable(size_t megabytes) { Resize(megabytes); }
+
+  void Resize(size_t megabytes) {
+    size_t count = 1;
+    while (count * 2 * sizeof(Slot) <= megabytes * 1024 * 1024) {
+      count *= 2;
+    }
+    slots_ = std::make_unique<Slot[]>(count);
+    mask_ = count - 1;
+    Clear();
+  }
+
+  void Clear() {
+    for (size_t i = 0; i <= mask_; ++i) {
+      slots_[i].key.store(0, std::memory_order_relaxed);
+      slots_[i].data.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  bool Probe(uint64_t key, int ply, Entry& entry) const {
+    const Slot& slot = slots_[key & mask_];
+    uint64_t data = slot.data.load(std::memory_order_relaxed);
+    uint64_t check = slot.key.load(std::memory_order_relaxed);
+    if ((check ^ data) != key || data == 0) {
+      return false;
+    }
+    entry = Unpack(data);
+    entry.score = FromTT(entry.score, ply);
+    return true;
+  }
+
+  // Keeps the deeper entry of the same position, always replaces others.
+  void Store(uint64_t key, int ply, Move move, int score, int depth, Bound bound) {
+    Slot& slot = slots_[key & mask_];
+    uint64_t old_data = slot.data.load(std::memory_order_relaxed);
+    uint64_t old_key = slot.key.load(std::memory_order_relaxed) ^ old_data;
+    if (old_key == key && old_data != 0) {
+      Entry old = Unpack(old_data);
+      if (old.depth > depth && bound != Bound::kExact) {
+        return;
+      }
+      if (move == Move::None()) {
+        move = old.move;
+      }
+    }
+    uint64_t data = Pack(Entry{move, ToTT(score, ply), depth, bound});
+    slot.data.store(data, std::memory_order_relaxed);
+    slot.key.store(key ^ data, std::memory_order_relaxed);
+  }
+
+  // Per mille of used slots in the first thousand.
+  int Hashfull() const {
+    int used = 0;
+    for (size_t i = 0; i < 1000 && i <= mask_; ++i) {
+      used += slots_[i].data.load(std::memory_order_relaxed) != 0;
+    }
+    return used;
+  }
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> key{0};
+    std::atomic<uint64_t> data{0};
+  };
+
+  // Win scores are stored relative to the node, not to the root.
+  static int ToTT(int score, int ply) {
+    if (score > kMaxEval) return score + ply;
+    if (score < -kMaxEval) return score - ply;
+    return score;
+  }
+
+  static int FromTT(int score, int ply) {
+    if (score > kMaxEval) return score - ply;
+    if (score < -kMaxEval) return score + ply;
+    return score;
+  }
+
+  // [15:0] move, [31:16] score, [39:32] depth, [41:40] bound.
+  static uint64_t Pack(const Entry& e) {
+    return uint64_t{e.move.Raw()} |
+        (uint64_t{static_cast<uint16_t>(static_cast<int16_t>(e.score))} << 16) |
+        (uint64_t{static_cast<uint8_t>(e.depth)} << 32) |
+        (uint64_t{static_cast<uint8_t>(e.bound)} << 40);
+  }
+
+  static Entry Unpack(uint64_t data) {
+    return Entry{
+      Move::FromRaw(static_cast<uint16_t>(data)),
+      static_cast<int16_t>(static_cast<uint16_t>(data >> 16)),
+      static_cast<uint8_t>(data >> 32),
+      static_cast<Bound>((data >> 40) & 3),
+    };
+  }
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_ = 0;
+};
@@ -0,0 +1,143 @@
+#include "variation_tree.h"
+
+#include <algorithm>
+
+VariationTree::VariationTree(const Position& root, int checkpoint_interval)
+  : interval_(std::max(checkpoint_interval, 1)), pos_(root) {
+  nodes_.push_back(Node{.move = Move::None(), .checkpoint = 0});
+  checkpoints_.push_back(root);
+}
+
+VariationTree::NodeId VariationTree::Play(Move move) {
+  NodeId last = kNoNode;
+  for (NodeId child = FirstChild(current_); child != kNoNode; child = NextSibling(child)) {
+    if (MoveOf(child) == move) {
+      MakeMove(child);
+      return child;
+    }
+    last = child;
+  }
+
+  NodeId child = nodes_.size();
+  nodes_.push_back(Node{.move = move, .depth = Depth(current_) + 1, .parent = current_});
+  if (last == kNoNode) {
+    nodes_[current_].first_child = child;
+  } else {
+    nodes_[last].next_sibling = child;
+  }
+  MakeMove(child);
+  if (Depth(child) % interval_ == 0) {
+    nodes_[child].checkpoint = checkpoints_.size();
+    checkpoints_.push_back(pos_);
+  }
+  return child;
+}
+
+bool VariationTree::Undo() {
+  if (current_ == kRoot) {
+    return false;
+  }
+  JumpTo(Parent(current_));
+  return true;
+}
+
+bool VariationTree::Redo() {
+  NodeId child = nodes_[current_].redo;
+  if (child == kNoNode) {
+    return false;
+  }
+  MakeMove(child);
+  return true;
+}
+
+bool VariationTree::NextBranch() {
+  if (current_ == kRoot || NextSibling(current_) == kNoNode) {
+    return false;
+  }
+  JumpTo(NextSibling(current_));
+  return true;
+}
+
+bool VariationTree::PreviousBranch() {
+  if (current_ == kRoot || FirstChild(Parent(current_)) == current_) {
+    return false;
+  }
+  JumpTo(PreviousSibling(current_));
+  return true;
+}
+
+void VariationTree::JumpTo(NodeId node) {
+  // Walk up from both nodes to their closest common ancestor, recording
+  // the path down to the target.
+  path_.clear();
+  NodeId up = current_;
+  NodeId down = node;
+  size_t unmakes = 0;
+  while (Depth(down) > Depth(up)) {
+    path_.push_back(down);
+    down = Parent(down);
+  }
+  while (Depth(up) > Depth(down)) {
+    up = Parent(up);
+    ++unmakes;
+  }
+  while (up != down) {
+    path_.push_back(down);
+    down = Parent(down);
+    up = Parent(up);
+    ++unmakes;
+  }
+  for (NodeId child : path_) {
+    nodes_[Parent(child)].redo = child;
+  }
+
+  // Moves from the current node against a copy of the checkpoint plus the
+  // moves from it.
+  size_t replays = Depth(node) % interval_;
+  if (unmakes <= steps_.size() && unmakes + path_.size() <= replays + 1) {
+    for (size_t i = 0; i < unmakes; ++i) {
+      UnmakeMove();
+    }
+    for (auto it = path_.rbegin(); it != path_.rend(); ++it) {
+      MakeMove(*it);
+    }
+  } else {
+    Rebuild(node);
+  }
+}
+
+VariationTree::NodeId VariationTree::PreviousSibling(NodeId node) const {
+  NodeId previous = kNoNode;
+  for (NodeId child = FirstChild(Parent(node)); child != node; child = NextSibling(child)) {
+    previous = child;
+  }
+  return previous;
+}
+
+void VariationTree::Rebuild(NodeId node) {
+  path_.clear();
+  while (nodes_[node].checkpoint == kNoCheckpoint) {
+    path_.push_back(node);
+    node = Parent(node);
+  }
+  pos_ = checkpoints_[nodes_[node].checkpoint];
+  current_ = node;
+  steps_.clear();
+  for (auto it = path_.rbegin(); it != path_.rend(); ++it) {
+    MakeMove(*it);
+  }
+}
+
+void VariationTree::MakeMove(NodeId child) {
+  Move move = MoveOf(child);
+  steps_.push_back(Step{.move = move, .undo = pos_.MakeMove(move)});
+  nodes_[current_].redo = child;
+  current_ = child;
+}
+
+void VariationTree::UnmakeMove() {
+  const Step& step = steps_.back();
+  pos_.UnmakeMove(step.move, step.undo);
+  steps_.pop_back();
+  current_ = Parent(current_);
+}
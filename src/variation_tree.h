@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "position.h"
+
+// Tree of the lines explored from a root position, for analysis sessions.
+// A node stores its move and its links; variations that branch off share
+// the nodes of their common prefix. The position of a node is rebuilt by
+// replaying the moves from the closest ancestor with a cached position
+// (a checkpoint), or by unmaking and making moves from the current node
+// when that is shorter.
+//
+// Nodes whose depth is a multiple of the checkpoint interval keep a copy
+// of their position: interval 1 caches every position, larger intervals
+// trade memory for at most interval - 1 moves replayed per jump.
+class VariationTree {
+ public:
+  using NodeId = uint32_t;
+  static constexpr NodeId kRoot = 0;
+  static constexpr NodeId kNoNode = UINT32_MAX;
+
+  explicit VariationTree(const Position& root, int checkpoint_interval = 8);
+
+  size_t Size() const { return nodes_.size(); }
+  int CheckpointInterval() const { return interval_; }
+
+  NodeId Current() const { return current_; }
+  const Position& CurrentPosition() const { return pos_; }
+
+  // Node structure. The children of a node are in the order they were
+  // first played.
+  Move MoveOf(NodeId node) const { return nodes_[node].move; }
+  NodeId Parent(NodeId node) const { return nodes_[node].parent; }
+  NodeId FirstChild(NodeId node) const { return nodes_[node].first_child; }
+  NodeId NextSibling(NodeId node) const { return nodes_[node].next_sibling; }
+  int Depth(NodeId node) const { return nodes_[node].depth; }
+
+  // Plays a legal move from the current node. Returns the child of the
+  // move, which is created if the move was not played here before.
+  NodeId Play(Move move);
+
+  // Goes back to the parent. The node is kept and Redo returns to it.
+  bool Undo();
+  // Goes to the child that was current last, if any.
+  bool Redo();
+  // Goes to the next or the previous sibling of the current node.
+  bool NextBranch();
+  bool PreviousBranch();
+
+  void JumpTo(NodeId node);
+
+ private:
+  static constexpr uint32_t kNoCheckpoint = UINT32_MAX;
+
+  struct Node {
+    Move move;
+    int32_t depth = 0;
+    NodeId parent = kNoNode;
+    NodeId first_child = kNoNode;
+    NodeId next_sibling = kNoNode;
+    // Child to go to on Redo.
+    NodeId redo = kNoNode;
+    uint32_t checkpoint = kNoCheckpoint;
+  };
+
+  struct Step {
+    Move move;
+    Position::UndoInfo undo;
+  };
+
+  NodeId PreviousSibling(NodeId node) const;
+  // Rebuilds the position of the node from its closest checkpoint.
+  void Rebuild(NodeId node);
+  void MakeMove(NodeId child);
+  void UnmakeMove();
+
+  int interval_;
+  std::vector<Node> nodes_;
+  std::vector<Position> checkpoints_;
+  NodeId current_ = kRoot;
+  Position pos_;
+  // Moves from the node pos_ was last rebuilt at down to the current node,
+  // which Undo and JumpTo can take back without a rebuild.
+  std::vector<Step> steps_;
+  // Path of the last jump, reused.
+  std::vector<NodeId> path_;
+};
@@ -1,91 +1,154 @@
 #include "zertz.h"
 
-bool Zertz::MoveToBoard(int ball_idx, QR to) const {
-  GameState state = Latest();
+#include "zobrist.h"
+
+namespace {
+
+// Index of a pile in ZobristKeys::count, in the order Position uses.
+int KeyPile(PileId id) {
+  return id == PileId::kTable ? 0 : 1 + static_cast<int>(id);
+}
 
-  auto& ball = state.balls[ball_idx];
-  auto& hex = state.board.Hex(to);
+void HashRing(ZState& state, QR pos) {
+  state.hash ^= ZobristKeys::Get().ring[state.board.Geometry().IndexOf(pos)];
+}
+
+void HashBall(ZState& state, QR pos, BallColor color) {
+  state.hash ^=
+      ZobristKeys::Get().ball[static_cast<int>(color)][state.board.Geometry().IndexOf(pos)];
+}
+
+// Called before the count of the color in the pile changes by `delta`.
+void HashCount(ZState& state, PileId id, BallColor color, int delta) {
+  const auto& keys = ZobristKeys::Get().count[KeyPile(id)][static_cast<int>(color)];
+  int count = state.GetPile(id).Count(color);
+  state.hash ^= keys[count] ^ keys[count + delta];
+}
+
+}
+
+bool Zertz::MoveToBoard(int ball_idx, QR to) const {
+  const auto& ball = state_.balls[ball_idx];
+  auto hex = state_.board.Hex(to);
   if (!hex.present || hex.ball_idx) {
     return false;
   }
   
-  // If it was on board, remove it from old hex
-  if (ball.OnBoard()) {
-    auto& old_hex = state.board.Hex(std::get<QR>(ball.position));
-    old_hex.ball_idx = {};
-  } else {
-    auto& old_pile = state.piles[ball.GetPile()];
-    old_pile.Remove(ball_idx);
-  }
-
-  hex.ball_idx = ball_idx;
-  ball.position = to;
-  Evolve(state);
+  Evolve(Delta{.type = Delta::Type::kMoveBall, .ball_idx = ball_idx,
+               .from = ball.position, .to = to});
   return true;
 }
 
 bool Zertz::MoveToPile(int ball_idx, PileId to) const {
-  GameState state = Latest();
-  auto& ball = state.balls[ball_idx];
+  const auto& ball = state_.balls[ball_idx];
   if (!ball.OnBoard() && ball.GetPile() == to) {
     return false;
   }
   
-  if (ball.OnBoard()) {
-    auto& old_hex = state.board.Hex(std::get<QR>(ball.position));
-    old_hex.ball_idx = {};
-  } else {
-    auto& old_pile = state.piles[ball.GetPile()];
-    old_pile.Remove(ball_idx);
-  }
-  
-  ball.position = to;
-  auto& new_pile = state.piles.at(to);
-  new_pile.Add(ball_idx);
-
-  auto index_in_pile = new_pile.GetIndex(ball_idx);
-  assert(index_in_pile);
-  Evolve(state);
+  Evolve(Delta{.type = Delta::Type::kMoveBall, .ball_idx = ball_idx,
+               .from = ball.position, .to = to});
+  assert(state_.GetPile(to).GetIndex(ball_idx));
   return true;
 }
 
 bool Zertz::RemoveCell(QR pos) const {
-  GameState state = Latest();
-  auto& hex = state.board.Hex(pos);
+  auto hex = state_.board.Hex(pos);
   if (!hex.present || hex.ball_idx) {
     return false;
   }
   
-  hex.present = false;
-  Evolve(state);
+  Evolve(Delta{.type = Delta::Type::kRemoveCell, .cell = pos});
   return true;
 }
 
 bool Zertz::Undo() const {
-  if (history_.size() == 1) {
+  if (history_.empty()) {
     return false;
   }
+  Revert(history_.back());
   history_.pop_back();
+  ++version_;
   return true;
 }
 
+void Zertz::Apply(Delta& delta) const {
+  if (delta.type == Delta::Type::kRemoveCell) {
+    HashRing(state_, delta.cell);
+    state_.board.RemoveRing(delta.cell);
+    return;
+  }
 
-Zertz::GameState Zertz::InitState() const {
-  GameState state{.board = ZBoard(3), .balls = {}, .piles = {}};
-  state.piles[PileId::kTable] = Pile{};
-  state.piles[PileId::kPlayer1] = Pile{};
-  state.piles[PileId::kPlayer2] = Pile{};
+  auto& ball = state_.balls[delta.ball_idx];
+  // If it was on board, remove it from old hex
+  if (ball.OnBoard()) {
+    HashBall(state_, ball.GetQR(), ball.color);
+    state_.board.Clear(ball.GetQR(), ball.color);
+  } else {
+    HashCount(state_, ball.GetPile(), ball.color, -1);
+    delta.from_slot = state_.GetPile(ball.GetPile()).Remove(delta.ball_idx, ball.color);
+  }
+
+  ball.position = delta.to;
+  if (ball.OnBoard()) {
+    HashBall(state_, ball.GetQR(), ball.color);
+    state_.board.Place(ball.GetQR(), delta.ball_idx, ball.color);
+  } else {
+    HashCount(state_, ball.GetPile(), ball.color, 1);
+    state_.GetPile(ball.GetPile()).Add(delta.ball_idx, ball.color);
+  }
+}
+
+void Zertz::Revert(const Delta& delta) const {
+  if (delta.type == Delta::Type::kRemoveCell) {
+    HashRing(state_, delta.cell);
+    state_.board.RestoreRing(delta.cell);
+    return;
+  }
+
+  auto& ball = state_.balls[delta.ball_idx];
+  if (ball.OnBoard()) {
+    HashBall(state_, ball.GetQR(), ball.color);
+    state_.board.Clear(ball.GetQR(), ball.color);
+  } else {
+    HashCount(state_, ball.GetPile(), ball.color, -1);
+    state_.GetPile(ball.GetPile()).Remove(delta.ball_idx, ball.color);
+  }
+
+  ball.position = delta.from;
+  if (ball.OnBoard()) {
+    HashBall(state_, ball.GetQR(), ball.color);
+    state_.board.Place(ball.GetQR(), delta.ball_idx, ball.color);
+  } else {
+    HashCount(state_, ball.GetPile(), ball.color, 1);
+    state_.GetPile(ball.GetPile()).Insert(delta.ball_idx, ball.color, delta.from_slot);
+  }
+}
+
+
+Zertz::GameState Zertz::InitState(BoardVariant variant) {
+  GameState state{.board = ZBoard(variant), .balls = {}, .piles = {}, .hash = 0};
   int ball_id = 0;
   auto AddBalls = [&] (int n, auto color) {
     for (int i = 0; i < n; ++i) {
       state.balls.emplace_back(color, PileId::kTable);
-      state.piles[PileId::kTable].Add(ball_id);
+      state.GetPile(PileId::kTable).Add(ball_id, color);
       ++ball_id;
     }
   };
 
-  AddBalls(6, Ball::Color::kWhite);
-  AddBalls(8, Ball::Color::kGrey);
-  AddBalls(10, Ball::Color::kBlack);
+  auto supply = InitialSupply(variant);
+  AddBalls(supply[0], Ball::Color::kWhite);
+  AddBalls(supply[1], Ball::Color::kGrey);
+  AddBalls(supply[2], Ball::Color::kBlack);
+
+  const auto& keys = ZobristKeys::Get();
+  for (int cell : SetBits{state.board.Bits().rings}) {
+    state.hash ^= keys.ring[cell];
+  }
+  for (PileId id : {PileId::kPlayer1, PileId::kPlayer2, PileId::kTable}) {
+    for (int c = 0; c < kNumColors; ++c) {
+      state.hash ^= keys.count[KeyPile(id)][c][state.GetPile(id).Count(static_cast<BallColor>(c))];
+    }
+  }
   return state;
-}
\ No newline at end of file
+}
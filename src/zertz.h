@@ -11,6 +11,7 @@
 #include <variant>
 #include <memory>
 
+#include "bitboard.h"
 #include "game.h"
 #include "structures.h"
 
@@ -18,7 +19,7 @@ struct Ball {
   using Position = std::variant<PileId, QR>;
   using Id = int;
 
-  enum class Color { kWhite, kGrey, kBlack };
+  using Color = BallColor;
   Ball(Color c, Position pos) : color(c), position(pos) {}
 
   const Color color;
@@ -39,41 +40,77 @@ struct Ball {
   }
 };
 
+// Fixed-capacity set of balls. Balls are kept densely in slots, removal moves
+// the last ball into the freed slot, so every operation is O(1) and the pile
+// never allocates.
 class Pile {
  public:
   using Id = PileId;
 
-  void Add(int ball_id) {
-    auto it = ball_id_to_index.find(ball_id);
-    assert(it == ball_id_to_index.end());
-    ball_ids.push_back(ball_id);
-    RebuildIndex();
+  // Enough for the ball supply of any board variant.
+  static constexpr int kCapacity = 48;
+
+  Pile() {
+    slot_of_.fill(kNoSlot);
+  }
+
+  void Add(int ball_id, Ball::Color color) {
+    Insert(ball_id, color, size_);
   }
   
-  void Remove(int ball_id) {
-    auto it = ball_id_to_index.find(ball_id);
-    assert(it != ball_id_to_index.end());
-    ball_ids.erase(ball_ids.begin() + it->second);
-    RebuildIndex();
+  // Returns the index the ball had in the pile.
+  int Remove(int ball_id, Ball::Color color) {
+    assert(Contains(ball_id));
+    int index = slot_of_[ball_id];
+    int last = balls_[size_ - 1];
+    balls_[index] = last;
+    slot_of_[last] = index;
+    slot_of_[ball_id] = kNoSlot;
+    --size_;
+    --counts_[static_cast<int>(color)];
+    return index;
+  }
+
+  // Puts the ball back to the index returned by Remove.
+  void Insert(int ball_id, Ball::Color color, int index) {
+    assert(!Contains(ball_id));
+    assert(size_ < kCapacity && index <= size_);
+    int moved = balls_[index];
+    if (index != size_) {
+      balls_[size_] = moved;
+      slot_of_[moved] = size_;
+    }
+    balls_[index] = ball_id;
+    slot_of_[ball_id] = index;
+    ++size_;
+    ++counts_[static_cast<int>(color)];
   }
   
   std::optional<int> GetIndex(int ball_id) const {
-    auto it = ball_id_to_index.find(ball_id);
-    if (it != ball_id_to_index.end()) {
-      return it->second;
+    if (Contains(ball_id)) {
+      return slot_of_[ball_id];
     }
     return std::nullopt;
   }
+
+  bool Contains(int ball_id) const {
+    assert(ball_id >= 0 && ball_id < kCapacity);
+    return slot_of_[ball_id] != kNoSlot;
+  }
+
+  // Id of the ball at the index, 0 <= index < Size().
+  int At(int index) const { return balls_[index]; }
+
+  int Count(Ball::Color color) const { return counts_[static_cast<int>(color)]; }
+  int Size() const { return size_; }
   
  private:
-  void RebuildIndex() {
-    ball_id_to_index.clear();
-    for (int i = 0; i < ball_ids.size(); ++i) {
-      ball_id_to_index[ball_ids[i]] = i;
-    }
-  }
-  std::vector<int> ball_ids;
-  std::map<int, int> ball_id_to_index;
+  static constexpr int8_t kNoSlot = -1;
+
+  std::array<int8_t, kCapacity> balls_{};
+  std::array<int8_t, kCapacity> slot_of_;
+  std::array<uint8_t, kNumColors> counts_{};
+  int8_t size_ = 0;
 };
 
 struct Cell {
@@ -81,25 +118,62 @@ struct Cell {
   std::optional<int> ball_idx;
 };
 
-struct ZBoard : public Board<Cell> {
-  // Board with flat side, size 2N + 1;
-  ZBoard(int N) : Board(2 * N + 1) {
-    for (int q = 0; q < Height(); ++q) {
-      for (int r = 0; r < Width(); ++r) {
-        // Make cells outside of main hexagon absent.
-        if ((r < N && q < N - r) || (r > N && q > 3 * N - r)) {
-          Hex(q, r).present = false;
-        } else {
-          Hex(q, r).present = true;
-        }
-      }
+// Bitboard-backed board. Ball identities are kept next to the masks so that
+// the GUI can still ask which ball sits on a hex.
+struct ZBoard {
+  ZBoard(BoardVariant variant = BoardVariant::kRings37)
+    : bits_(HexGeometry::Get(variant)) {
+    ball_ids_.fill(kNoBall);
+  }
+
+  Cell Hex(QR pos) const {
+    int idx = Geometry().IndexOf(pos);
+    if (idx == HexGeometry::kNoCell || !bits_.HasRing(idx)) {
+      return Cell{};
+    }
+    Cell cell{.present = true, .ball_idx = {}};
+    if (ball_ids_[idx] != kNoBall) {
+      cell.ball_idx = ball_ids_[idx];
     }
+    return cell;
   }
-  
-  Cell& Hex(QR pos) { return Hex(pos.q, pos.r); }
-  const Cell& Hex(QR pos) const { return Hex(pos.q, pos.r); }
-  Cell& Hex(int q, int r) { return Get(q, r); }
-  const Cell& Hex(int q, int r) const { return Get(q, r); }
+
+  Cell Hex(int q, int r) const { return Hex(QR{q, r}); }
+
+  // Puts a ball on a present and vacant hex.
+  void Place(QR pos, BallId ball_id, BallColor color) {
+    int idx = IndexOf(pos);
+    bits_.Place(idx, color);
+    ball_ids_[idx] = ball_id;
+  }
+
+  // Takes the ball off the hex.
+  void Clear(QR pos, BallColor color) {
+    int idx = IndexOf(pos);
+    bits_.Clear(idx, color);
+    ball_ids_[idx] = kNoBall;
+  }
+
+  void RemoveRing(QR pos) { bits_.RemoveRing(IndexOf(pos)); }
+  void RestoreRing(QR pos) { bits_.RestoreRing(IndexOf(pos)); }
+
+  const BitBoard& Bits() const { return bits_; }
+  const HexGeometry& Geometry() const { return *bits_.geometry; }
+
+  int Height() const { return Geometry().grid; }
+  int Width() const { return Geometry().grid; }
+
+ private:
+  static constexpr int8_t kNoBall = -1;
+
+  int IndexOf(QR pos) const {
+    int idx = Geometry().IndexOf(pos);
+    assert(idx != HexGeometry::kNoCell);
+    return idx;
+  }
+
+  BitBoard bits_;
+  std::array<int8_t, HexGeometry::kMaxCells> ball_ids_;
 };
 
 class Zertz {
@@ -107,12 +181,26 @@ class Zertz {
   struct GameState {
     ZBoard board;
     std::vector<Ball> balls;
-    std::map<PileId, Pile> piles;
+    std::array<Pile, 3> piles;
+    // Zobrist key (see zobrist.h) of the rings, the balls on the board and
+    // the ball counts of the piles, kept up to date by every move and undo.
+    // The state does not know whose turn it is, so this is the key of the
+    // engine Position with player 1 to move.
+    uint64_t hash = 0;
+
+    Pile& GetPile(PileId id) { return piles[static_cast<int>(id)]; }
+    const Pile& GetPile(PileId id) const { return piles[static_cast<int>(id)]; }
   };
 
-  Zertz() : history_({InitState()}) { }
+  explicit Zertz(BoardVariant variant = BoardVariant::kRings37)
+    : state_(InitState(variant)) { }
   
-  GameState Latest() const { return history_.back(); }
+  // The current state. The reference stays valid for the lifetime of the
+  // game, Version() tells whether it changed since it was last read.
+  const GameState& Latest() const { return state_; }
+
+  // Incremented by every move and undo.
+  uint64_t Version() const { return version_; }
   
   // The possible moves. 
   // Returns true if move was successful and state was updated.
@@ -123,13 +211,33 @@ class Zertz {
   bool Undo() const;
   
  private:
-  void Evolve(GameState new_state) const {
-    history_.push_back(std::move(new_state));
+  // A single change of the state. History is a log of these, so that any
+  // move can be applied and reverted in place.
+  struct Delta {
+    enum class Type { kMoveBall, kRemoveCell };
+
+    Type type;
+    int ball_idx = -1;
+    Ball::Position from, to;
+    // Index of the ball in its pile before the move, filled on apply.
+    int from_slot = 0;
+    QR cell{};
+  };
+
+  void Evolve(Delta delta) const {
+    Apply(delta);
+    history_.push_back(delta);
+    ++version_;
   }
   
-  GameState InitState() const;
+  void Apply(Delta& delta) const;
+  void Revert(const Delta& delta) const;
+
+  static GameState InitState(BoardVariant variant);
  
-  mutable std::vector<GameState> history_;
+  mutable GameState state_;
+  mutable std::vector<Delta> history_;
+  mutable uint64_t version_ = 0;
 };
 
 using ZState = Zertz::GameState;
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+#include "bitboard.h"
+
+// Random keys for Zobrist hashing of positions. The key of a position is the
+// xor of the keys of every present ring, every ball (by color and cell), the
+// ball count of every color in every pile, the side to move and the cell of
+// an unfinished capture chain. Zertz::GameState keeps a key made of the
+// same keys, without the side to move.
+struct ZobristKeys {
+  // Piles: the supply and the captures of the two players.
+  static constexpr int kNumPiles = 3;
+  static constexpr int kMaxCount = 64;
+
+  static const ZobristKeys& Get() {
+    static const ZobristKeys kKeys;
+    return kKeys;
+  }
+
+  std::array<uint64_t, HexGeometry::kMaxCells> ring;
+  std::array<std::array<uint64_t, HexGeometry::kMaxCells>, kNumColors> ball;
+  std::array<std::array<std::array<uint64_t, kMaxCount>, kNumColors>, kNumPiles> count;
+  std::array<uint64_t, HexGeometry::kMaxCells> chain;
+  uint64_t side;
+
+ private:
+  ZobristKeys() {
+    // Fixed seed, so that keys are stable between runs and processes.
+    uint64_t state = 0x5A3272747A5A3272;
+    auto Next = [&state] () {
+      // splitmix64
+      uint64_t z = (state += 0x9E3779B97F4A7C15);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+      return z ^ (z >> 31);
+    };
+    for (auto& key : ring) {
+      key = Next();
+    }
+    for (auto& keys : ball) {
+      for (auto& key : keys) {
+        key = Next();
+      }
+    }
+    for (auto& pile : count) {
+      for (auto& keys : pile) {
+        for (auto& key : keys) {
+          key = Next();
+        }
+      }
+    }
+    for (auto& key : chain) {
+      key = Next();
+    }
+    side = Next();
+  }
+};